@@ -0,0 +1,76 @@
+#include "defs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Compares a crew of identical systems run one thread each with the same crew merged by `manager_aggregate`.
+// Every member consumes 1 Oxygen every 2 ms from a tank large enough to never run out during the run.
+
+#define RUN_MS 1000          // Wall-clock milliseconds the crew runs for, the flow is measured over the whole run
+#define TANK 100000000       // Initial Oxygen, far more than any crew can breathe in RUN_MS
+
+/**
+ * Runs `crew` members for `RUN_MS` milliseconds and prints threads, lock operations and the Oxygen flow.
+ *
+ * @param[in] crew       Number of crew members.
+ * @param[in] aggregate  non-zero to merge the members before starting.
+ */
+static void run_configuration(int crew, int aggregate) {
+    Manager manager;
+    Resource *oxygen;
+    ResourceAmount consume_oxygen, produce_nothing;
+    long lock_operations = 0;
+
+    manager_init(&manager);
+    manager.display_enabled = 0;
+    resource_create(&oxygen, "Oxygen", TANK, TANK);
+    resource_array_add(&manager.resource_array, oxygen);
+    resource_amount_init(&consume_oxygen, oxygen, 1);
+    resource_amount_init(&produce_nothing, NULL, 0);
+    for (int i = 0; i < crew; i++) {
+        System *member;
+        system_create(&member, "Crew", consume_oxygen, produce_nothing, 2, &manager.event_queue);
+        system_array_add(&manager.system_array, member);
+    }
+    if (aggregate) {
+        manager_aggregate(&manager);
+    }
+
+    struct timespec start, end;
+    int threads = manager.system_array.size;
+    pthread_t *handles = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&handles[i], NULL, system_thread, manager.system_array.systems[i]);
+    }
+    usleep(RUN_MS * 1000);
+    for (int i = 0; i < threads; i++) {
+        manager.system_array.systems[i]->status = TERMINATE;
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(handles[i], NULL);
+        lock_operations += manager.system_array.systems[i]->metrics.cycles + manager.system_array.systems[i]->metrics.failed_cycles;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(handles);
+
+    double elapsed_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+
+    printf("%-10s %8d %8d %14ld %16.0f %16d\n", aggregate ? "aggregate" : "separate", crew, threads, lock_operations,
+           (TANK - oxygen->amount) * 1000.0 / elapsed_ms, crew * 500);
+    manager_clean(&manager);
+}
+
+int main(void) {
+    int crews[] = {10, 100, 500};
+
+    printf("%-10s %8s %8s %14s %16s %16s\n", "mode", "crew", "threads", "lock ops", "oxygen/s", "ideal oxygen/s");
+    for (unsigned i = 0; i < sizeof(crews) / sizeof(crews[0]); i++) {
+        run_configuration(crews[i], 0);
+        run_configuration(crews[i], 1);
+    }
+
+    return 0;
+}
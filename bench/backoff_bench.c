@@ -0,0 +1,92 @@
+#include "defs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+// Compares the fixed, adaptive, park and queue retry strategies of `system_run`.
+// A single consumer waits on an empty resource; after each outage one unit is added and the time until the
+// consumer takes it is measured, together with the events and retries the outage cost.
+
+#define ROUNDS 10   // Outages simulated per configuration
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Runs `ROUNDS` outages of `outage_ms` milliseconds against one consumer using `strategy`, and prints the results.
+ *
+ * @param[in] strategy   `BACKOFF_FIXED`, `BACKOFF_ADAPTIVE`, `BACKOFF_PARK` or `BACKOFF_QUEUE`.
+ * @param[in] outage_ms  Length of each outage in milliseconds.
+ */
+static void run_configuration(int strategy, int outage_ms) {
+    Manager manager;
+    Resource *fuel;
+    System *engine;
+    ResourceAmount consume_fuel, produce_nothing;
+    pthread_t thread;
+    double total_latency = 0.0, max_latency = 0.0;
+
+    manager_init(&manager);
+    manager.display_enabled = 0;
+    resource_create(&fuel, "Fuel", 0, 100);
+    resource_array_add(&manager.resource_array, fuel);
+    resource_amount_init(&consume_fuel, fuel, 1);
+    resource_amount_init(&produce_nothing, NULL, 0);
+    system_create(&engine, "Engine", consume_fuel, produce_nothing, 1, &manager.event_queue);
+    system_array_add(&manager.system_array, engine);
+    engine->backoff_strategy = strategy;
+
+    pthread_create(&thread, NULL, system_thread, engine);
+
+    for (int round = 0; round < ROUNDS; round++) {
+        usleep(outage_ms * 1000);
+
+        lock_acquire(&fuel->lock);
+        fuel->amount = 1;
+        resource_wake_waiters(fuel);
+        lock_release(&fuel->lock);
+        double refilled = now_seconds();
+
+        while (__atomic_load_n(&fuel->amount, __ATOMIC_ACQUIRE) != 0) {
+            sched_yield();
+        }
+        double latency = (now_seconds() - refilled) * 1000.0;
+        total_latency += latency;
+        if (latency > max_latency) {
+            max_latency = latency;
+        }
+    }
+
+    engine->status = TERMINATE;
+    resource_wake_all(fuel);
+    pthread_join(thread, NULL);
+
+    const char *names[] = {"fixed", "adaptive", "park", "queue"};
+    printf("%-9s %10d %12.1f %12.1f %14.3f %14.3f\n", names[strategy], outage_ms,
+           (double)engine->metrics.events / ROUNDS, (double)engine->metrics.retries / ROUNDS,
+           total_latency / ROUNDS, max_latency);
+
+    manager_clean(&manager);
+}
+
+int main(void) {
+    int outages[] = {1, 10, 100, 1000};
+
+    printf("%-9s %10s %12s %12s %14s %14s\n", "strategy", "outage ms", "events/out", "retries/out",
+           "mean react ms", "max react ms");
+
+    for (unsigned i = 0; i < sizeof(outages) / sizeof(outages[0]); i++) {
+        run_configuration(BACKOFF_FIXED, outages[i]);
+        run_configuration(BACKOFF_ADAPTIVE, outages[i]);
+        run_configuration(BACKOFF_PARK, outages[i]);
+        run_configuration(BACKOFF_QUEUE, outages[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "defs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Compares how long the manager takes to change the speed of every producer of a resource, writing each
+// producer's status or the resource's shared control word, and what reading the speed costs a producer.
+
+#define CHANGES 2000   // Speed changes measured per configuration
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Loads one resource produced by `producers` systems and measures alternating FAST/SLOW events on it.
+ *
+ * @param[in] producers      Number of systems producing the resource.
+ * @param[in] group_control  non-zero to let the manager write the control word.
+ */
+static void run_configuration(int producers, int group_control) {
+    Manager manager;
+    Resource *tank, *source;
+    ResourceAmount consume_source, produce_tank;
+    Event event;
+    volatile long speed_sum = 0;
+
+    manager_init(&manager);
+    manager.display_enabled = 0;
+    manager.group_control = group_control;
+    resource_create(&source, "Source", 1000, 1000);
+    resource_create(&tank, "Tank", 500, 1000);
+    resource_array_add(&manager.resource_array, source);
+    resource_array_add(&manager.resource_array, tank);
+    resource_amount_init(&consume_source, source, 1);
+    resource_amount_init(&produce_tank, tank, 1);
+    for (int i = 0; i < producers; i++) {
+        System *producer;
+        system_create(&producer, "Pump", consume_source, produce_tank, 1, &manager.event_queue);
+        system_array_add(&manager.system_array, producer);
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < CHANGES; i++) {
+        event_init(&event, manager.system_array.systems[0], tank, (i & 1) ? STATUS_CAPACITY : STATUS_INSUFFICIENT,
+                   PRIORITY_HIGH, 0);
+        manager_handle_event(&manager, &event);
+    }
+    double write_ns = (now_seconds() - start) * 1e9 / CHANGES;
+
+    start = now_seconds();
+    for (int i = 0; i < CHANGES; i++) {
+        for (int p = 0; p < producers; p++) {
+            speed_sum += system_speed(manager.system_array.systems[p]);
+        }
+    }
+    double read_ns = (now_seconds() - start) * 1e9 / CHANGES / producers;
+
+    printf("%-10s %10d %18.1f %18.2f\n", group_control ? "group" : "per-system", producers, write_ns, read_ns);
+    manager_clean(&manager);
+}
+
+int main(void) {
+    int producer_counts[] = {1, 10, 100, 1000, 10000};
+
+    printf("%-10s %10s %18s %18s\n", "control", "producers", "ns/speed change", "ns/speed read");
+    for (unsigned i = 0; i < sizeof(producer_counts) / sizeof(producer_counts[0]); i++) {
+        run_configuration(producer_counts[i], 0);
+        run_configuration(producer_counts[i], 1);
+    }
+
+    return 0;
+}
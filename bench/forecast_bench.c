@@ -0,0 +1,69 @@
+#include "defs.h"
+#include <stdio.h>
+
+// Compares the reactive manager with the predictive one on the sample mission.
+// Runs in virtual time with the `Stepper`, so both modes see exactly the same system timings.
+// The missions end at different times, so each is first run to its end to find how long it lasts, then both are
+// run again, deterministically, only up to the end of the shorter one: the totals cover the same simulated horizon.
+
+#define MISSION_LIMIT 60000.0   // Virtual milliseconds after which a mission still running is stopped
+#define STEP 1.0                // Virtual milliseconds per step
+
+/**
+ * Runs the sample mission (`copies` times over) in one manager mode until it ends or reaches `limit`.
+ *
+ * @param[in] predictive  Non-zero to enable the predictive manager.
+ * @param[in] copies      Number of copies of the sample data.
+ * @param[in] limit       Virtual milliseconds after which the mission is stopped.
+ * @param[in] lasted      Length of the whole mission, printed with the totals; negative to print nothing.
+ * @return                Virtual milliseconds run.
+ */
+static double run_mission(int predictive, int copies, double limit, double lasted) {
+    Manager manager;
+    Stepper stepper;
+    SystemMetrics total = {0};
+
+    manager_init(&manager);
+    manager.display_enabled = 0;
+    manager.predictive = predictive;
+    for (int i = 0; i < copies; i++) {
+        load_data(&manager);
+    }
+    manager_seed(&manager, DEFAULT_SEED);
+    stepper_init(&stepper, &manager);
+
+    while (manager.simulation_running && stepper.time < limit) {
+        stepper_advance(&stepper, &manager, STEP);
+    }
+
+    for (int i = 0; i < manager.system_array.size; i++) {
+        SystemMetrics *metrics = &manager.system_array.systems[i]->metrics;
+        total.cycles += metrics->cycles;
+        total.failed_cycles += metrics->failed_cycles;
+        total.failed_stores += metrics->failed_stores;
+        total.events += metrics->events;
+    }
+
+    if (lasted >= 0.0) {
+        printf("%-10s %10.0f %10.0f %10ld %10ld %10ld %10ld %14.1f %12ld\n", predictive ? "predictive" : "reactive",
+               lasted, stepper.time, total.cycles, total.failed_cycles, total.failed_stores, total.events,
+               1000.0 * total.failed_cycles / (total.cycles > 0 ? total.cycles : 1), manager.proactive_switches);
+    }
+
+    double time = stepper.time;
+    stepper_clean(&stepper);
+    manager_clean(&manager);
+    return time;
+}
+
+int main(void) {
+    double reactive = run_mission(0, 1, MISSION_LIMIT, -1.0);
+    double predictive = run_mission(1, 1, MISSION_LIMIT, -1.0);
+    double horizon = (reactive < predictive) ? reactive : predictive;
+
+    printf("%-10s %10s %10s %10s %10s %10s %10s %14s %12s\n", "manager", "lasted ms", "counted ms", "cycles", "failed",
+           "full", "events", "failed/1k cyc", "proactive");
+    run_mission(0, 1, horizon, reactive);
+    run_mission(1, 1, horizon, predictive);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "defs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Measures the wasted attempts of consumers racing for a scarce resource with each retry strategy.
+// A Refinery adds a batch of Fuel every few milliseconds while more Engines than it can feed wait for it, and one
+// critical Pump with a higher weight needs the same Fuel. With "park" a refill wakes every consumer it reaches
+// the level of and most of them fail again (a thundering herd); with "queue" it is handed over in order and only
+// the consumers it feeds are woken. Reports the failed attempts per successful cycle (and those made right after
+// a wakeup, the races lost), the wakeups, and how the Fuel was shared: the Pump's cycles against an average Engine
+// and the spread between the Engines. A last row runs "queue" in reserve mode, where a woken consumer is not handed
+// its input but has it set aside, and takes it itself on its next attempt.
+//
+// Usage: herd_bench [--engines N] [--batch UNITS] [--period MS] [--weight W] [--ms MS]
+
+#define HERD_MAX_ENGINES 64
+#define HERD_MAX_WEIGHT 1000000
+
+/**
+ * Runs the scenario with every consumer using `strategy`, in reserve mode if `reserve` is set, and prints one row.
+ */
+static void run_configuration(int strategy, int reserve, int engines, int batch, int period, int weight, int ms) {
+    Manager manager;
+    Resource *fuel;
+    System *refinery, *pump, *engine[HERD_MAX_ENGINES];
+    ResourceAmount consume_nothing, produce_fuel, consume_fuel, produce_nothing;
+    pthread_t threads[HERD_MAX_ENGINES + 2];
+
+    manager_init(&manager);
+    manager.display_enabled = 0;
+    resource_create(&fuel, "Fuel", 0, batch * 4);
+    resource_array_add(&manager.resource_array, fuel);
+    resource_amount_init(&consume_nothing, NULL, 0);
+    resource_amount_init(&produce_fuel, fuel, batch);
+    resource_amount_init(&consume_fuel, fuel, 1);
+    resource_amount_init(&produce_nothing, NULL, 0);
+
+    system_create(&refinery, "Refinery", consume_nothing, produce_fuel, period, &manager.event_queue);
+    system_create(&pump, "Pump", consume_fuel, produce_nothing, 1, &manager.event_queue);
+    system_array_add(&manager.system_array, refinery);
+    system_array_add(&manager.system_array, pump);
+    for (int i = 0; i < engines; i++) {
+        system_create(&engine[i], "Engine", consume_fuel, produce_nothing, 1, &manager.event_queue);
+        system_array_add(&manager.system_array, engine[i]);
+    }
+    for (int i = 0; i < manager.system_array.size; i++) {
+        manager.system_array.systems[i]->backoff_strategy = strategy;
+        manager.system_array.systems[i]->reserve_output = reserve;
+        manager.system_array.systems[i]->silent = 1;   // No manager runs, the events would only pile up
+    }
+    pump->weight = weight;
+
+    for (int i = 0; i < manager.system_array.size; i++) {
+        pthread_create(&threads[i], NULL, system_thread, manager.system_array.systems[i]);
+    }
+    usleep(ms * 1000);
+    for (int i = 0; i < manager.system_array.size; i++) {
+        manager.system_array.systems[i]->status = TERMINATE;
+    }
+    resource_wake_all(fuel);
+    for (int i = 0; i < manager.system_array.size; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    long cycles = pump->metrics.cycles, failed = pump->metrics.failed_cycles;
+    long wakeups = pump->metrics.parks, handoffs = pump->metrics.handoffs, lost = pump->metrics.lost_races;
+    long engine_cycles = 0, fewest = engine[0]->metrics.cycles, most = engine[0]->metrics.cycles;
+    for (int i = 0; i < engines; i++) {
+        SystemMetrics *metrics = &engine[i]->metrics;
+        cycles += metrics->cycles;
+        failed += metrics->failed_cycles;
+        wakeups += metrics->parks;
+        handoffs += metrics->handoffs;
+        lost += metrics->lost_races;
+        engine_cycles += metrics->cycles;
+        fewest = (metrics->cycles < fewest) ? metrics->cycles : fewest;
+        most = (metrics->cycles > most) ? metrics->cycles : most;
+    }
+    double average = (double)engine_cycles / engines;
+
+    const char *names[] = {"fixed", "adaptive", "park", "queue"};
+    char name[16];
+    snprintf(name, sizeof(name), "%s%s", names[strategy], reserve ? "/res" : "");
+    printf("%-9s %9ld %12.3f %12.3f %12.3f %10ld %11.2f %11.2f\n", name, cycles, (double)failed / cycles,
+           (double)lost / cycles, (double)wakeups / cycles, handoffs, average > 0 ? pump->metrics.cycles / average : 0.0,
+           most > 0 ? (double)fewest / most : 0.0);
+
+    manager_clean(&manager);
+}
+
+int main(int argc, char *argv[]) {
+    int engines = 16, batch = 8, period = 2, weight = 4, ms = 2000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--engines") == 0 && i + 1 < argc) {
+            engines = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--period") == 0 && i + 1 < argc) {
+            period = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--weight") == 0 && i + 1 < argc) {
+            char *end;
+            long parsed = strtol(argv[++i], &end, 10);
+            weight = (*end == '\0' && end != argv[i] && parsed <= HERD_MAX_WEIGHT) ? (int)parsed : 0;
+        } else if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (engines < 1 || engines > HERD_MAX_ENGINES || batch < 1 || period < 1 || weight < 1 || ms < 1) {
+        fprintf(stderr, "Invalid settings\n");
+        return 1;
+    }
+
+    printf("%d engines and a pump of weight %d, %d units every %d ms\n", engines, weight, batch, period);
+    printf("%-9s %9s %12s %12s %12s %10s %11s %11s\n", "strategy", "cycles", "failed/cyc", "lost/cyc", "wakeups/cyc",
+           "handoffs", "pump/engine", "min/max");
+    for (int strategy = BACKOFF_FIXED; strategy <= BACKOFF_QUEUE; strategy++) {
+        run_configuration(strategy, 0, engines, batch, period, weight, ms);
+    }
+    run_configuration(BACKOFF_QUEUE, 1, engines, batch, period, weight, ms);
+    return 0;
+}
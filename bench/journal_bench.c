@@ -0,0 +1,146 @@
+#include "defs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Records an hour of virtual time into a journal and measures how long seeking to arbitrary times takes.
+// Changes are synthetic (random amounts, stored amounts and statuses at a steady rate) so the recording
+// is reproducible; the state expected at each seek time is kept aside and compared with what the seek rebuilds.
+
+#define BENCH_SCALE 25                  // Copies of the sample data, 100 resources and 100 systems
+#define BENCH_DURATION (3600.0 * 1000.0)   // Milliseconds recorded
+#define BENCH_CHANGES_PER_MS 2          // Changes recorded per virtual millisecond
+#define BENCH_SEEKS 20
+#define BENCH_PATH "journal_bench.bin"
+
+static double now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(void) {
+    Manager manager;
+    Journal journal;
+    Rng rng;
+    double seek_times[BENCH_SEEKS];
+    int *expected[BENCH_SEEKS];
+
+    manager_init(&manager);
+    manager.display_enabled = 0;
+    for (int i = 0; i < BENCH_SCALE; i++) {
+        load_data(&manager);
+    }
+    int resources = manager.resource_array.size, systems = manager.system_array.size;
+    int values = resources + 2 * systems;
+    int *current = (int *)calloc(values, sizeof(int));
+
+    rng_seed(&rng, DEFAULT_SEED, 0);
+    for (int i = 0; i < BENCH_SEEKS; i++) {
+        seek_times[i] = rng_uniform(&rng) * BENCH_DURATION;
+        expected[i] = (int *)malloc(sizeof(int) * values);
+    }
+    qsort(seek_times, BENCH_SEEKS, sizeof(double), compare_doubles);
+
+    if (journal_open(&journal, BENCH_PATH, &manager) != 0) {
+        fprintf(stderr, "Cannot create %s\n", BENCH_PATH);
+        return 1;
+    }
+    journal.virtual_time = 1;
+    for (int i = 0; i < resources; i++) {
+        current[i] = manager.resource_array.resources[i]->amount;
+    }
+    for (int i = 0; i < systems; i++) {
+        current[resources + i] = manager.system_array.systems[i]->amount_stored;
+        current[resources + systems + i] = manager.system_array.systems[i]->status;
+    }
+
+    double start = now_ms();
+    int next_seek = 0;
+    for (int ms = 1; ms <= (int)BENCH_DURATION; ms++) {
+        journal.time = ms;
+        while (next_seek < BENCH_SEEKS && seek_times[next_seek] < ms) {
+            memcpy(expected[next_seek++], current, sizeof(int) * values);
+        }
+        for (int c = 0; c < BENCH_CHANGES_PER_MS; c++) {
+            int index = (int)(rng_next(&rng) % (uint64_t)values);
+            int value = (int)(rng_next(&rng) % 1000);
+            current[index] = value;
+            if (index < resources) {
+                journal_record(&journal, JOURNAL_RESOURCE, index, value);
+            } else if (index < resources + systems) {
+                journal_record(&journal, JOURNAL_STORED, index - resources, value);
+            } else {
+                journal_record(&journal, JOURNAL_STATUS, index - resources - systems, value);
+            }
+        }
+        if (journal.time - journal.snapshot_time >= JOURNAL_SNAPSHOT_INTERVAL) {
+            // The snapshot reads the live simulation, keep it equal to what was recorded
+            for (int i = 0; i < resources; i++) {
+                manager.resource_array.resources[i]->amount = current[i];
+            }
+            for (int i = 0; i < systems; i++) {
+                manager.system_array.systems[i]->amount_stored = current[resources + i];
+                manager.system_array.systems[i]->status = current[resources + systems + i];
+            }
+            journal_snapshot(&journal, &manager);
+        }
+    }
+    while (next_seek < BENCH_SEEKS) {
+        memcpy(expected[next_seek++], current, sizeof(int) * values);
+    }
+    if (journal_close(&journal) != 0) {
+        fprintf(stderr, "Cannot write %s\n", BENCH_PATH);
+        return 1;
+    }
+    double record_ms = now_ms() - start;
+
+    FILE *file = fopen(BENCH_PATH, "rb");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    printf("Recorded %.0f s: %ld changes, %d snapshots, %.1f MB in %.0f ms (%.0f ns per change)\n",
+           BENCH_DURATION / 1000.0, journal.records, journal.index_count, size / 1e6, record_ms,
+           record_ms * 1e6 / journal.records);
+
+    double total = 0.0, worst = 0.0;
+    int mismatches = 0;
+    for (int i = 0; i < BENCH_SEEKS; i++) {
+        SimState state;
+        long replayed;
+        double snapshot_time;
+
+        start = now_ms();
+        journal_seek(BENCH_PATH, seek_times[i], &state, &snapshot_time, &replayed);
+        double elapsed = now_ms() - start;
+        total += elapsed;
+        if (elapsed > worst) {
+            worst = elapsed;
+        }
+
+        for (int r = 0; r < resources; r++) {
+            mismatches += persistent_array_get(&state.resource_amounts, r) != expected[i][r];
+        }
+        for (int s = 0; s < systems; s++) {
+            mismatches += persistent_array_get(&state.system_stored, s) != expected[i][resources + s];
+            mismatches += persistent_array_get(&state.system_status, s) != expected[i][resources + systems + s];
+        }
+        sim_state_clean(&state);
+    }
+    printf("%d seeks: mean %.3f ms, worst %.3f ms, %d mismatched values\n", BENCH_SEEKS, total / BENCH_SEEKS, worst,
+           mismatches);
+
+    for (int i = 0; i < BENCH_SEEKS; i++) {
+        free(expected[i]);
+    }
+    free(current);
+    remove(BENCH_PATH);
+    manager_clean(&manager);
+    return mismatches != 0;
+}
@@ -0,0 +1,115 @@
+#include "lock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+// Measures the lock chosen with LOCK_STRATEGY under the critical sections used by the simulation.
+// `make bench-locks` builds and runs it once per strategy to produce the full matrix.
+
+#define OPERATIONS_PER_THREAD 200000
+
+#define SECTION_CONVERT 0   // Check and take the input, like `system_consume`
+#define SECTION_STORE   1   // Compute the free space and add what fits, like `system_store_resources`
+#define SECTION_MIXED   2   // Alternate both, like a system consuming and producing the same resource
+
+// Stand-in for a `Resource`, with only what the critical sections touch
+typedef struct BenchResource {
+    int amount;
+    int max_capacity;
+    Lock lock;
+} BenchResource;
+
+typedef struct BenchThread {
+    BenchResource *resource;
+    int section;
+    pthread_t thread;
+} BenchThread;
+
+static void section_convert(BenchResource *resource) {
+    lock_acquire(&resource->lock);
+    if (resource->amount >= 1) {
+        resource->amount -= 1;
+    }
+    lock_release(&resource->lock);
+}
+
+static void section_store(BenchResource *resource) {
+    lock_acquire(&resource->lock);
+    int available_space = resource->max_capacity - resource->amount;
+    int stored = (available_space >= 1) ? 1 : available_space;
+    if (stored > 0) {
+        resource->amount += stored;
+    }
+    lock_release(&resource->lock);
+}
+
+static void *bench_thread(void *arg) {
+    BenchThread *bench = (BenchThread *)arg;
+
+    for (int i = 0; i < OPERATIONS_PER_THREAD; i++) {
+        if (bench->section == SECTION_CONVERT || (bench->section == SECTION_MIXED && (i & 1))) {
+            section_convert(bench->resource);
+        } else {
+            section_store(bench->resource);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Runs `threads` threads hammering one resource with `section` and returns the throughput.
+ *
+ * @param[in] threads  Number of threads sharing the resource.
+ * @param[in] section  One of the SECTION_ workloads.
+ * @return             Critical sections completed per microsecond.
+ */
+static double run(int threads, int section) {
+    BenchResource resource;
+    BenchThread *benches = (BenchThread *)malloc(sizeof(BenchThread) * threads);
+    struct timespec start, end;
+
+    resource.amount = 1 << 29;
+    resource.max_capacity = 1 << 30;
+    lock_init(&resource.lock);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < threads; i++) {
+        benches[i].resource = &resource;
+        benches[i].section = section;
+        pthread_create(&benches[i].thread, NULL, bench_thread, &benches[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(benches[i].thread, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    lock_destroy(&resource.lock);
+    free(benches);
+
+    double elapsed_us = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+    return (double)threads * OPERATIONS_PER_THREAD / elapsed_us;
+}
+
+int main(int argc, char *argv[]) {
+    int thread_counts[] = {1, 2, 4, 8, 16};
+    const char *section_names[] = {"convert", "store", "mixed"};
+
+    if (argc > 1 && strcmp(argv[1], "--header") == 0) {
+        printf("%-9s %-8s", "lock", "section");
+        for (unsigned t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+            printf(" %7d thr", thread_counts[t]);
+        }
+        printf("   (million sections/s)\n");
+    }
+
+    for (int section = SECTION_CONVERT; section <= SECTION_MIXED; section++) {
+        printf("%-9s %-8s", LOCK_NAME, section_names[section]);
+        for (unsigned t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+            printf(" %11.2f", run(thread_counts[t], section));
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "defs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Compares the standard and reserve modes of `system_run` on a producer whose output is usually full.
+// A fast Filler feeds a small Tank drained by a slow Drain; the Filler spends most of its time blocked on capacity.
+// Columns: Filler cycles, full (refused stores or reservations), events/s sent by the Filler, mean units the Filler
+// held while blocked, and cycles of the Drain.
+
+#define RUN_MS 2000   // Wall-clock milliseconds measured per configuration
+
+/**
+ * Runs the Filler and the Drain for `RUN_MS` milliseconds and prints what the Filler's blocked time cost.
+ *
+ * @param[in] reserve   non-zero to run both systems in reserve mode.
+ * @param[in] strategy  `BACKOFF_FIXED`, `BACKOFF_ADAPTIVE` or `BACKOFF_PARK`.
+ */
+static void run_configuration(int reserve, int strategy) {
+    Manager manager;
+    Resource *source, *tank;
+    System *filler, *drain;
+    ResourceAmount consume_source, produce_tank, consume_tank, produce_nothing;
+    pthread_t filler_thread, drain_thread;
+    long held_samples = 0, held_total = 0;
+    const char *names[] = {"fixed", "adaptive", "park"};
+
+    manager_init(&manager);
+    manager.display_enabled = 0;
+    resource_create(&source, "Source", 1000000, 1000000);
+    resource_create(&tank, "Tank", 0, 20);
+    resource_array_add(&manager.resource_array, source);
+    resource_array_add(&manager.resource_array, tank);
+    resource_amount_init(&consume_source, source, 1);
+    resource_amount_init(&produce_tank, tank, 5);
+    resource_amount_init(&consume_tank, tank, 1);
+    resource_amount_init(&produce_nothing, NULL, 0);
+    system_create(&filler, "Filler", consume_source, produce_tank, 2, &manager.event_queue);
+    system_create(&drain, "Drain", consume_tank, produce_nothing, 5, &manager.event_queue);
+    system_array_add(&manager.system_array, filler);
+    system_array_add(&manager.system_array, drain);
+    for (int i = 0; i < manager.system_array.size; i++) {
+        manager.system_array.systems[i]->reserve_output = reserve;
+        manager.system_array.systems[i]->backoff_strategy = strategy;
+    }
+
+    pthread_create(&filler_thread, NULL, system_thread, filler);
+    pthread_create(&drain_thread, NULL, system_thread, drain);
+
+    for (int t = 0; t < RUN_MS; t++) {
+        usleep(1000);
+        held_total += __atomic_load_n(&filler->amount_stored, __ATOMIC_RELAXED);
+        held_samples++;
+    }
+
+    filler->status = TERMINATE;
+    drain->status = TERMINATE;
+    resource_wake_all(source);   // A refused reservation parks on its output, and park mode on either resource
+    resource_wake_all(tank);
+    pthread_join(filler_thread, NULL);
+    pthread_join(drain_thread, NULL);
+
+    printf("%-8s %-9s %10ld %10ld %12.1f %12.2f %12ld\n", reserve ? "reserve" : "standard",
+           names[strategy], filler->metrics.cycles, filler->metrics.failed_stores,
+           filler->metrics.events * 1000.0 / RUN_MS, (double)held_total / held_samples, drain->metrics.cycles);
+
+    manager_clean(&manager);
+}
+
+int main(void) {
+    printf("%-8s %-9s %10s %10s %12s %12s %12s\n", "mode", "backoff", "cycles", "full", "events/s", "mean held",
+           "drained");
+
+    for (int strategy = BACKOFF_FIXED; strategy <= BACKOFF_PARK; strategy++) {
+        run_configuration(0, strategy);
+        run_configuration(1, strategy);
+    }
+
+    return 0;
+}
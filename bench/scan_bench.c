@@ -0,0 +1,114 @@
+#include "defs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Compares the cost of a manager tick in event mode and with the threshold scan on a large scenario.
+// In event mode the cost grows with the number of failures reported since the last tick;
+// the scan costs one gather and one compare per resource whatever happens in the simulation.
+
+#define COPIES 25000   // Copies of the sample data, four resources each
+#define TICKS 200      // Manager ticks measured per configuration
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Measures event mode: `failures` events are reported before every tick and handled by the manager.
+ *
+ * @param[in,out] manager   Pointer to the loaded `Manager`.
+ * @param[in]     failures  Events sent per tick, spread over the Energy resources.
+ * @return                  Microseconds per tick, including sending the events.
+ */
+static double run_events(Manager *manager, int failures) {
+    Event event;
+    double start = now_seconds();
+
+    for (int tick = 0; tick < TICKS; tick++) {
+        for (int i = 0; i < failures; i++) {
+            System *life_support = manager->system_array.systems[(i % COPIES) * 4 + 1];
+            event_init(&event, life_support, life_support->consumed.resource, STATUS_INSUFFICIENT, PRIORITY_HIGH, 0);
+            event_queue_push(&manager->event_queue, &event);
+        }
+        while (event_queue_pop(&manager->event_queue, &event)) {
+            manager_handle_event(manager, &event);
+        }
+    }
+
+    return (now_seconds() - start) * 1e6 / TICKS;
+}
+
+/**
+ * Measures the two halves of the threshold scan, which see the same resources whatever the failure rate.
+ *
+ * @param[in,out] manager     Pointer to the loaded `Manager`.
+ * @param[out]    gather_us   Microseconds per tick spent copying the amounts into the contiguous array.
+ * @param[out]    scalar_us   Microseconds per tick spent comparing them one at a time.
+ * @param[out]    simd_us     Microseconds per tick spent comparing them with AVX2 (negative if unsupported).
+ */
+static void run_scan(Manager *manager, double *gather_us, double *scalar_us, double *simd_us) {
+    ThresholdScan *scan = &manager->threshold_scan;
+    int has_simd;
+    double start;
+
+    manager_scan(manager);  // Builds the scan and handles the crossings present at the start
+    has_simd = scan->use_simd;
+
+    start = now_seconds();
+    for (int tick = 0; tick < TICKS; tick++) {
+        threshold_scan_gather(scan, manager);
+    }
+    *gather_us = (now_seconds() - start) * 1e6 / TICKS;
+
+    scan->use_simd = 0;
+    start = now_seconds();
+    for (int tick = 0; tick < TICKS; tick++) {
+        threshold_scan_compare(scan);
+    }
+    *scalar_us = (now_seconds() - start) * 1e6 / TICKS;
+
+    *simd_us = -1.0;
+    if (has_simd) {
+        scan->use_simd = 1;
+        start = now_seconds();
+        for (int tick = 0; tick < TICKS; tick++) {
+            threshold_scan_compare(scan);
+        }
+        *simd_us = (now_seconds() - start) * 1e6 / TICKS;
+    }
+}
+
+int main(void) {
+    int failure_counts[] = {0, 100, 1000, 10000, 100000};
+    double gather_us, scalar_us, simd_us;
+    Manager manager;
+
+    manager_init(&manager);
+    manager.display_enabled = 0;
+    for (int i = 0; i < COPIES; i++) {
+        load_data(&manager);
+    }
+
+    printf("%d resources, %d systems\n", manager.resource_array.size, manager.system_array.size);
+    printf("%-28s %12s\n", "mode", "us/tick");
+    for (unsigned i = 0; i < sizeof(failure_counts) / sizeof(failure_counts[0]); i++) {
+        char label[64];
+        snprintf(label, sizeof(label), "events, %d failures", failure_counts[i]);
+        printf("%-28s %12.1f\n", label, run_events(&manager, failure_counts[i]));
+    }
+
+    run_scan(&manager, &gather_us, &scalar_us, &simd_us);
+    printf("%-28s %12.1f\n", "scan gather", gather_us);
+    printf("%-28s %12.1f\n", "scan compare, scalar", scalar_us);
+    if (simd_us >= 0.0) {
+        printf("%-28s %12.1f\n", "scan compare, avx2", simd_us);
+    } else {
+        printf("%-28s %12s\n", "scan compare, avx2", "unsupported");
+    }
+
+    manager_clean(&manager);
+    return 0;
+}
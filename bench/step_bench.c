@@ -0,0 +1,79 @@
+#include "rocketsim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures the cost of `rocketsim_step` and checks that stepping does not allocate.
+// Built with -Wl,--wrap=malloc -Wl,--wrap=calloc so every allocation made by the library is counted here.
+
+#define WARMUP_MS 1000   // Virtual milliseconds simulated before measuring
+#define MEASURE_MS 5000  // Virtual milliseconds measured
+#define STEP_MS 1.0      // Step size used by the co-simulation
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+
+static long allocation_count = 0;
+
+void *__wrap_malloc(size_t size) {
+    allocation_count++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocation_count++;
+    return __real_calloc(count, size);
+}
+
+/**
+ * Loads `copies` independent pairs of systems moving units back and forth between two resources.
+ *
+ * Unlike the sample mission this never terminates, so every measured step does a full amount of work.
+ *
+ * @param[in,out] sim     Pointer to the `RocketSim` to load.
+ * @param[in]     copies  Number of resource pairs to create.
+ */
+static void load_steady_state(RocketSim *sim, int copies) {
+    for (int i = 0; i < copies; i++) {
+        int tank_a = rocketsim_add_resource(sim, "Tank A", 500, 1000);
+        int tank_b = rocketsim_add_resource(sim, "Tank B", 500, 1000);
+        rocketsim_add_system(sim, "Forward", tank_a, 2, tank_b, 2, 1);
+        rocketsim_add_system(sim, "Backward", tank_b, 1, tank_a, 1, 1);
+    }
+}
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(void) {
+    int sizes[] = {1, 10, 100, 1000};
+
+    printf("%10s %14s %18s %14s\n", "systems", "ns/step", "ns/system-ms", "allocations");
+
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        RocketSim *sim = rocketsim_init(1);
+        struct timespec start, end;
+
+        load_steady_state(sim, sizes[i]);
+        for (int t = 0; t < WARMUP_MS; t++) {
+            rocketsim_step(sim, STEP_MS);
+        }
+
+        long allocations_before = allocation_count;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int t = 0; t < MEASURE_MS; t++) {
+            rocketsim_step(sim, STEP_MS);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double ns_per_step = elapsed_seconds(&start, &end) * 1e9 / MEASURE_MS;
+        int systems = rocketsim_system_count(sim);
+        printf("%10d %14.0f %18.1f %14ld\n", systems, ns_per_step, ns_per_step / systems / STEP_MS,
+               allocation_count - allocations_before);
+
+        rocketsim_destroy(sim);
+    }
+
+    return 0;
+}
@@ -0,0 +1,329 @@
+#include "defs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Finds the event rate at which the manager saturates.
+// Synthetic producer threads push a configurable mix of statuses and priorities into the `EventQueue` at a fixed
+// total rate, while the main thread runs the manager loop of `manager_thread` (`manager_run`, sleep).
+// The rate doubles each stage until the queue no longer drains between ticks; every stage reports the offered
+// and handled rates, the queue depth seen at each tick and the time from push to dispatch. Events are counted
+// and timed in one place, the manager's event hook, so every event `manager_run` dispatches is seen.
+//
+// Usage: storm_bench [--producers N] [--workers N] [--resources N] [--rate R] [--max-rate R] [--stage MS]
+//                    [--mix STATUS:PRIORITY:WEIGHT,...]
+// STATUS is low, empty, insufficient or capacity; the default mix is what failing systems send.
+// Build with another LOCK_STRATEGY (see `make bench-locks`) to compare queue locks.
+
+#define STORM_MAX_PRODUCERS 64
+#define STORM_MAX_MIX 8
+#define STORM_SEQUENCE_BITS 20              // Low bits of an event's amount: index into its producer's push times
+#define STORM_RING (1 << STORM_SEQUENCE_BITS)
+#define STORM_PRODUCERS_PER_RESOURCE 8      // Systems changed by each speed change
+#define STORM_PACE_MS 1                     // Producers push what is due every millisecond
+#define STORM_RESERVED_NODES 65536          // Queue nodes allocated up front, so the first stages do not measure malloc
+#define STORM_MAX_DEPTH (1 << 19)           // Queue depth at which producers drop events instead of exhausting memory
+#define STORM_DEFAULT_MIX "low:3:4,insufficient:3:1,empty:3:1,capacity:1:4"
+
+// One kind of event of the mix
+typedef struct StormKind {
+    int status;
+    int priority;
+    int weight;
+} StormKind;
+
+// Settings shared by every producer
+typedef struct Storm {
+    Manager *manager;
+    StormKind kinds[STORM_MAX_MIX];
+    int kind_count;
+    int total_weight;
+    int producers;
+    double rate;            // Events per second of the current stage, over all producers
+    double stage_end;       // Time at which the producers stop, so a flooded manager loop still ends
+} Storm;
+
+// One synthetic producer thread
+typedef struct StormProducer {
+    Storm *storm;
+    int index;
+    long pushed;
+    long dropped;           // Events not pushed because the queue was already `STORM_MAX_DEPTH` deep
+    double *pushed_at;      // Push time in milliseconds of each sequence number, modulo `STORM_RING`
+    Rng rng;
+    pthread_t thread;
+} StormProducer;
+
+// Events seen by the manager's event hook during a stage
+typedef struct StormStage {
+    StormProducer *producers;
+    double *latencies;      // Push to dispatch time of the first `capacity` events
+    long capacity;
+    long handled;
+} StormStage;
+
+static double now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Parses a mix such as "low:3:4,capacity:1:4" into `storm->kinds`.
+ *
+ * @param[out] storm  Pointer to the `Storm` to fill.
+ * @param[in]  spec   Comma separated STATUS:PRIORITY:WEIGHT entries.
+ * @return            0 on success, -1 on an unknown status or too many entries.
+ */
+static int parse_mix(Storm *storm, const char *spec) {
+    char copy[256];
+    const char *names[] = {"empty", "low", "insufficient", "capacity"};
+    int statuses[] = {STATUS_EMPTY, STATUS_LOW, STATUS_INSUFFICIENT, STATUS_CAPACITY};
+
+    snprintf(copy, sizeof(copy), "%s", spec);
+    storm->kind_count = 0;
+    storm->total_weight = 0;
+    for (char *entry = strtok(copy, ","); entry; entry = strtok(NULL, ",")) {
+        char name[32];
+        StormKind kind = {-1, PRIORITY_MED, 1};
+
+        if (storm->kind_count == STORM_MAX_MIX || sscanf(entry, "%31[^:]:%d:%d", name, &kind.priority, &kind.weight) < 1) {
+            return -1;
+        }
+        for (int i = 0; i < 4; i++) {
+            if (strcmp(name, names[i]) == 0) {
+                kind.status = statuses[i];
+            }
+        }
+        if (kind.status < 0 || kind.weight <= 0) {
+            return -1;
+        }
+        storm->kinds[storm->kind_count++] = kind;
+        storm->total_weight += kind.weight;
+    }
+    return storm->kind_count > 0 ? 0 : -1;
+}
+
+/**
+ * Pushes this producer's share of the rate, in bursts of what is due every `STORM_PACE_MS`, until the stage ends.
+ * A queue already `STORM_MAX_DEPTH` deep gets no more events; they are counted as dropped.
+ *
+ * The event's amount carries the producer and sequence number, so the manager loop can find its push time.
+ *
+ * @param[in,out] arg  Pointer to the `StormProducer`.
+ * @return             NULL.
+ */
+static void *producer_thread(void *arg) {
+    StormProducer *producer = (StormProducer *)arg;
+    Storm *storm = producer->storm;
+    ResourceArray *resources = &storm->manager->resource_array;
+    double start = now_ms();
+    double per_ms = storm->rate / 1000.0 / storm->producers;
+    Event event;
+
+    while (now_ms() < storm->stage_end) {
+        long due = (long)((now_ms() - start) * per_ms);
+        while (producer->pushed + producer->dropped < due) {
+            if (__atomic_load_n(&storm->manager->event_queue.size, __ATOMIC_RELAXED) >= STORM_MAX_DEPTH) {
+                producer->dropped++;
+                continue;
+            }
+            int pick = (int)(rng_next(&producer->rng) % (uint64_t)storm->total_weight);
+            StormKind *kind = storm->kinds;
+            while (pick >= kind->weight) {
+                pick -= kind->weight;
+                kind++;
+            }
+            Resource *resource = resources->resources[rng_next(&producer->rng) % (uint64_t)resources->size];
+            int sequence = (int)(producer->pushed & (STORM_RING - 1));
+
+            producer->pushed_at[sequence] = now_ms();
+            event_init(&event, resource->producers[0], resource, kind->status, kind->priority,
+                       (producer->index << STORM_SEQUENCE_BITS) | sequence);
+            event_queue_push(&storm->manager->event_queue, &event);
+            producer->pushed++;
+        }
+        usleep(STORM_PACE_MS * 1000);
+    }
+    return NULL;
+}
+
+/**
+ * Event hook of the manager: counts the event and records how long after its push it was dispatched.
+ *
+ * @param[in,out] context  Pointer to the `StormStage`.
+ * @param[in]     event    The event being dispatched; its amount carries the producer and sequence number.
+ */
+static void stage_event_hook(void *context, const Event *event) {
+    StormStage *stage = (StormStage *)context;
+    StormProducer *producer = &stage->producers[event->amount >> STORM_SEQUENCE_BITS];
+
+    if (stage->handled < stage->capacity) {
+        stage->latencies[stage->handled] = now_ms() - producer->pushed_at[event->amount & (STORM_RING - 1)];
+    }
+    stage->handled++;
+}
+
+/**
+ * Runs one stage at `storm->rate` for `stage_ms` and prints a line of results.
+ *
+ * @param[in,out] storm      Pointer to the `Storm`.
+ * @param[in,out] producers  The producer threads' state.
+ * @param[in]     stage_ms   Length of the stage in milliseconds.
+ * @return                   Non-zero if the manager could not keep up.
+ */
+static int run_stage(Storm *storm, StormProducer *producers, double stage_ms) {
+    Manager *manager = storm->manager;
+    StormStage stage;
+    long ticks = 0;
+    double depth_total = 0.0;
+    int depth_max = 0;
+    Event event;
+
+    stage.producers = producers;
+    stage.capacity = (long)(storm->rate * stage_ms / 1000.0) + 1;
+    stage.latencies = (double *)malloc(sizeof(double) * stage.capacity);
+    stage.handled = 0;
+    manager->event_hook = stage_event_hook;
+    manager->event_hook_context = &stage;
+
+    double start = now_ms();
+    storm->stage_end = start + stage_ms;
+    for (int p = 0; p < storm->producers; p++) {
+        producers[p].pushed = 0;
+        producers[p].dropped = 0;
+        pthread_create(&producers[p].thread, NULL, producer_thread, &producers[p]);
+    }
+
+    while (now_ms() < storm->stage_end) {
+        int depth = __atomic_load_n(&manager->event_queue.size, __ATOMIC_RELAXED);
+        depth_total += depth;
+        if (depth > depth_max) {
+            depth_max = depth;
+        }
+        ticks++;
+
+        manager->clock = now_ms() - start;
+        manager_run(manager);
+        usleep(MANAGER_WAIT_TIME * 1000);
+    }
+    double elapsed = now_ms() - start;
+    manager->event_hook = NULL;
+
+    long pushed = 0, dropped = 0;
+    for (int p = 0; p < storm->producers; p++) {
+        pthread_join(producers[p].thread, NULL);
+        pushed += producers[p].pushed;
+        dropped += producers[p].dropped;
+    }
+    int backlog = manager->event_queue.size;
+    while (event_queue_pop(&manager->event_queue, &event)) {
+        // Drop what is left, the next stage starts from an empty queue
+    }
+
+    double *latencies = stage.latencies;
+    long measured = stage.handled < stage.capacity ? stage.handled : stage.capacity;
+    qsort(latencies, measured, sizeof(double), compare_doubles);
+    double offered = pushed / elapsed * 1000.0, rate = stage.handled / elapsed * 1000.0;
+    printf("%12.0f %12.0f %12.0f %10.1f %10d %10d %10ld %10.2f %10.2f %10.2f\n", storm->rate, offered, rate,
+           ticks > 0 ? depth_total / ticks : 0.0, depth_max, backlog, dropped,
+           measured > 0 ? latencies[measured / 2] : 0.0, measured > 0 ? latencies[measured * 99 / 100] : 0.0,
+           measured > 0 ? latencies[measured - 1] : 0.0);
+    free(latencies);
+
+    // Saturated once the manager handles clearly less than is offered, more than two ticks' worth is left over,
+    // or the producers cannot even offer the rate because the manager loop keeps them off the processors
+    double tick_ms = ticks > 0 ? elapsed / ticks : stage_ms;
+    return dropped > 0 || rate < 0.9 * offered || offered < 0.9 * storm->rate ||
+           backlog > 2.0 * offered * tick_ms / 1000.0 + 1;
+}
+
+int main(int argc, char *argv[]) {
+    Manager manager;
+    Storm storm;
+    StormProducer producers[STORM_MAX_PRODUCERS];
+    int workers = 0, resource_count = 16;
+    double rate = 20000.0, max_rate = 20000000.0, stage_ms = 500.0;
+    const char *mix = STORM_DEFAULT_MIX;
+
+    storm.producers = 4;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--producers") == 0 && i + 1 < argc) {
+            storm.producers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--resources") == 0 && i + 1 < argc) {
+            resource_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-rate") == 0 && i + 1 < argc) {
+            max_rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--stage") == 0 && i + 1 < argc) {
+            stage_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--mix") == 0 && i + 1 < argc) {
+            mix = argv[++i];
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (parse_mix(&storm, mix) != 0 || storm.producers < 1 || storm.producers > STORM_MAX_PRODUCERS || resource_count < 1) {
+        fprintf(stderr, "Invalid settings, mix \"%s\"\n", mix);
+        return 1;
+    }
+
+    manager_init(&manager);
+    manager.display_enabled = 0;
+    for (int r = 0; r < resource_count; r++) {
+        Resource *tank;
+        ResourceAmount consume_nothing, produce;
+        resource_create(&tank, "Tank", 500, 1000);
+        resource_array_add(&manager.resource_array, tank);
+        resource_amount_init(&consume_nothing, NULL, 0);
+        resource_amount_init(&produce, tank, 1);
+        for (int p = 0; p < STORM_PRODUCERS_PER_RESOURCE; p++) {
+            System *pump;
+            system_create(&pump, "Pump", consume_nothing, produce, 1, &manager.event_queue);
+            system_array_add(&manager.system_array, pump);
+        }
+    }
+    event_queue_reserve(&manager.event_queue, STORM_RESERVED_NODES);
+
+    storm.manager = &manager;
+    for (int p = 0; p < storm.producers; p++) {
+        producers[p].storm = &storm;
+        producers[p].index = p;
+        producers[p].pushed_at = (double *)malloc(sizeof(double) * STORM_RING);
+        rng_seed(&producers[p].rng, DEFAULT_SEED, p);
+    }
+
+    manager_start_workers(&manager, workers);
+    printf("%d producers, %d workers, %d resources, mix %s, %.0f ms stages\n", storm.producers, workers,
+           resource_count, mix, stage_ms);
+    printf("%12s %12s %12s %10s %10s %10s %10s %10s %10s %10s\n", "target/s", "offered/s", "handled/s", "depth avg",
+           "depth max", "backlog", "dropped", "p50 ms", "p99 ms", "max ms");
+
+    double sustained = 0.0;
+    for (storm.rate = rate; storm.rate <= max_rate; storm.rate *= 2) {
+        if (run_stage(&storm, producers, stage_ms)) {
+            printf("Saturated between %.0f and %.0f events/s\n", sustained, storm.rate);
+            break;
+        }
+        sustained = storm.rate;
+    }
+    manager_stop_workers(&manager);
+
+    for (int p = 0; p < storm.producers; p++) {
+        free(producers[p].pushed_at);
+    }
+    manager_clean(&manager);
+    return 0;
+}
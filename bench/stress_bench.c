@@ -0,0 +1,266 @@
+#include "defs.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Stress test of the resource critical sections, checking conservation while they run as fast as possible.
+// Producers, consumers and converters (consuming one resource and producing the next) share a few small
+// resources, so amounts hit both empty and full all the time. Each system is driven by its own thread through
+// `system_consume` (or `system_consume_reserved`) and `system_store_resources` like the `Stepper` does, without
+// processing time and without backoff sleeps. A checker thread keeps locking each resource and verifying
+//   0 <= amount, amount + reserved <= max_capacity, initial + produced - consumed == amount
+// and at the end the resource counters are compared with the units each thread counted itself, which catches
+// updates lost by a broken lock even when the counters were lost with them.
+// Both the standard and reserve modes are run; the exit status is 1 if any check failed.
+//
+// Usage: stress_bench [--header] [--resources N] [--systems N] [--capacity N] [--multiplicity N] [--ms MS]
+// `make stress` runs it once per LOCK_STRATEGY.
+
+#define STRESS_MAX_RESOURCES 64
+#define STRESS_MAX_SYSTEMS 256
+#define STRESS_MAX_REPORTS 10   // Violations printed in full, the rest are only counted
+
+// One system and the units its thread moved, counted without sharing anything
+typedef struct StressThread {
+    System *system;
+    long consumed;
+    long produced;
+    int *stop;
+    pthread_t thread;
+} StressThread;
+
+// State of the checker thread
+typedef struct StressChecker {
+    Manager *manager;
+    int initial[STRESS_MAX_RESOURCES];
+    long checks;
+    long violations;
+    int *stop;
+    pthread_t thread;
+} StressChecker;
+
+static double now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+/**
+ * Runs cycles of one system until stopped. A failed step yields the processor, the only pause taken.
+ *
+ * @param[in,out] arg  Pointer to the `StressThread`.
+ * @return             NULL.
+ */
+static void *stress_thread(void *arg) {
+    StressThread *stress = (StressThread *)arg;
+    System *system = stress->system;
+
+    while (!__atomic_load_n(stress->stop, __ATOMIC_RELAXED)) {
+        int progress = 0;
+
+        if (system->reserve_output) {
+            if (system_consume_reserved(system) == STATUS_OK) {
+                stress->consumed += (long)system->consumed.amount * system->active_copies;
+                stress->produced += (long)system->produced.amount * system->active_copies;
+                system_commit_reserved(system);
+                progress = 1;
+            }
+        } else {
+            if (system->amount_stored == 0 && system_consume(system) == STATUS_OK) {
+                stress->consumed += (long)system->consumed.amount * system->active_copies;
+                if (system->produced.resource) {
+                    system->amount_stored += system->produced.amount * system->active_copies;
+                }
+                progress = 1;
+            }
+            int held = system->amount_stored;
+            if (held > 0) {
+                system_store_resources(system);
+                stress->produced += held - system->amount_stored;
+                progress |= held != system->amount_stored;
+            }
+        }
+
+        if (!progress) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Checks one resource against its invariants.
+ *
+ * @return  Number of invariants broken.
+ */
+static int stress_check(StressChecker *checker, int index, int amount, int reserved, long produced, long consumed) {
+    Resource *resource = checker->manager->resource_array.resources[index];
+    int broken = (amount < 0) + (reserved < 0) + (amount + reserved > resource->max_capacity) +
+                 (checker->initial[index] + produced - consumed != amount);
+
+    if (broken > 0 && checker->violations < STRESS_MAX_REPORTS) {
+        printf("  violation on %s %d: amount %d, reserved %d, capacity %d, initial %d + produced %ld - consumed %ld = %ld\n",
+               resource->name, index, amount, reserved, resource->max_capacity, checker->initial[index], produced,
+               consumed, checker->initial[index] + produced - consumed);
+    }
+    checker->violations += broken > 0;
+    checker->checks++;
+    return broken;
+}
+
+/**
+ * Locks each resource in turn and checks it, round after round, until stopped.
+ *
+ * @param[in,out] arg  Pointer to the `StressChecker`.
+ * @return             NULL.
+ */
+static void *stress_checker(void *arg) {
+    StressChecker *checker = (StressChecker *)arg;
+    ResourceArray *resources = &checker->manager->resource_array;
+
+    while (!__atomic_load_n(checker->stop, __ATOMIC_RELAXED)) {
+        for (int i = 0; i < resources->size; i++) {
+            Resource *resource = resources->resources[i];
+            lock_acquire(&resource->lock);
+            int amount = resource->amount;
+            int reserved = resource->reserved;
+            long produced = resource->produced;
+            long consumed = resource->consumed;
+            lock_release(&resource->lock);
+            stress_check(checker, i, amount, reserved, produced, consumed);
+        }
+        sched_yield();
+    }
+    return NULL;
+}
+
+/**
+ * Builds the scenario, runs it for `ms` milliseconds and prints one row of results.
+ *
+ * System s is a producer, a consumer or a converter in turn, on resource s modulo the resource count;
+ * amounts per cycle go from 1 to 3 so partial stores and insufficient inputs happen as well as empty and full.
+ *
+ * @return  Number of violations found.
+ */
+static long run_stress(int reserve, int resource_count, int system_count, int capacity, int multiplicity, int ms) {
+    Manager manager;
+    StressThread threads[STRESS_MAX_SYSTEMS];
+    StressChecker checker;
+    int stop = 0;
+
+    manager_init(&manager);
+    manager.display_enabled = 0;
+    for (int r = 0; r < resource_count; r++) {
+        Resource *resource;
+        resource_create(&resource, (r % 2) ? "Oxygen" : "Fuel", capacity / 2, capacity);
+        resource_array_add(&manager.resource_array, resource);
+        checker.initial[r] = capacity / 2;
+    }
+    for (int s = 0; s < system_count; s++) {
+        Resource *resource = manager.resource_array.resources[s % resource_count];
+        Resource *next = manager.resource_array.resources[(s + 1) % resource_count];
+        ResourceAmount consumed, produced;
+        System *system;
+        int amount = 1 + (s / 3) % 3;
+
+        resource_amount_init(&consumed, (s % 3 == 0) ? NULL : resource, amount);
+        resource_amount_init(&produced, (s % 3 == 1) ? NULL : (s % 3 == 2) ? next : resource, 1 + (s / 3 + 1) % 3);
+        system_create(&system, "Stress", consumed, produced, 0, &manager.event_queue);
+        system->silent = 1;
+        system->reserve_output = reserve;
+        system->multiplicity = multiplicity;
+        system_array_add(&manager.system_array, system);
+
+        threads[s].system = system;
+        threads[s].consumed = 0;
+        threads[s].produced = 0;
+        threads[s].stop = &stop;
+    }
+
+    checker.manager = &manager;
+    checker.checks = 0;
+    checker.violations = 0;
+    checker.stop = &stop;
+
+    double start = now_ms();
+    for (int s = 0; s < system_count; s++) {
+        pthread_create(&threads[s].thread, NULL, stress_thread, &threads[s]);
+    }
+    pthread_create(&checker.thread, NULL, stress_checker, &checker);
+    usleep(ms * 1000);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (int s = 0; s < system_count; s++) {
+        pthread_join(threads[s].thread, NULL);
+    }
+    pthread_join(checker.thread, NULL);
+    double elapsed = now_ms() - start;
+
+    // Final state, and the counters against what the threads counted themselves
+    long cycles = 0;
+    for (int r = 0; r < resource_count; r++) {
+        Resource *resource = manager.resource_array.resources[r];
+        long consumed = 0, produced = 0;
+        for (int s = 0; s < system_count; s++) {
+            System *system = threads[s].system;
+            consumed += (system->consumed.resource == resource) ? threads[s].consumed : 0;
+            produced += (system->produced.resource == resource) ? threads[s].produced : 0;
+        }
+        stress_check(&checker, r, resource->amount, resource->reserved, produced, consumed);
+        if (consumed != resource->consumed || produced != resource->produced) {
+            printf("  counters of %s %d: consumed %ld counted %ld, produced %ld counted %ld\n", resource->name, r,
+                   resource->consumed, consumed, resource->produced, produced);
+            checker.violations++;
+        }
+    }
+    for (int s = 0; s < system_count; s++) {
+        cycles += threads[s].system->metrics.cycles;
+    }
+
+    printf("%-8s %-9s %9d %9d %12.0f %12.0f %10ld\n", reserve ? "reserve" : "standard", LOCK_NAME, resource_count,
+           system_count, cycles * 1000.0 / elapsed, checker.checks * 1000.0 / elapsed, checker.violations);
+
+    manager_clean(&manager);
+    return checker.violations;
+}
+
+int main(int argc, char *argv[]) {
+    int resource_count = 2, system_count = 24, capacity = 16, multiplicity = 1, ms = 1000;
+    int header = 0;
+    long violations = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--header") == 0) {
+            header = 1;
+        } else if (strcmp(argv[i], "--resources") == 0 && i + 1 < argc) {
+            resource_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--systems") == 0 && i + 1 < argc) {
+            system_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc) {
+            capacity = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--multiplicity") == 0 && i + 1 < argc) {
+            multiplicity = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (resource_count < 1 || resource_count > STRESS_MAX_RESOURCES || system_count < 1 ||
+        system_count > STRESS_MAX_SYSTEMS || capacity < 6 * multiplicity || multiplicity < 1 || ms < 1) {
+        fprintf(stderr, "Invalid settings\n");
+        return 1;
+    }
+
+    if (header) {
+        printf("%-8s %-9s %9s %9s %12s %12s %10s\n", "mode", "lock", "resources", "systems", "cycles/s", "checks/s",
+               "violations");
+    }
+    violations += run_stress(0, resource_count, system_count, capacity, multiplicity, ms);
+    violations += run_stress(1, resource_count, system_count, capacity, multiplicity, ms);
+    return violations > 0;
+}
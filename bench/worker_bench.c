@@ -0,0 +1,208 @@
+#include "defs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures the highest event rate the manager sustains as manager workers are added.
+// One large component: many resources, each produced by many systems, so every event changes the speed of
+// a whole producer group. Like storm_bench, producer threads push low/full events at a paced rate while the
+// main thread runs the loop of `manager_thread` (`manager_run`, sleep), and the rate doubles each stage until the
+// manager falls behind; events are counted by the manager's event hook. For each worker count the last rate
+// sustained is printed with what was handled at it, and the rate at which it saturated.
+//
+// Usage: worker_bench [--producers N] [--rate R] [--max-rate R] [--stage MS]
+
+#define RESOURCES 256              // Resources in the component
+#define PRODUCERS_PER_RESOURCE 64  // Systems producing each resource
+#define WORKER_BENCH_MAX_PRODUCERS 16
+#define WORKER_BENCH_PACE_MS 1             // Producers push what is due every millisecond
+#define WORKER_BENCH_MAX_DEPTH (1 << 19)   // Queue depth at which a stage is abandoned as saturated
+
+// One thread pushing its share of the rate
+typedef struct PushThread {
+    Manager *manager;
+    int index;
+    double per_ms;          // Events due per millisecond
+    double stage_end;       // Time at which the thread stops pushing
+    long pushed;
+    int overflowed;         // non-zero once the queue reached `WORKER_BENCH_MAX_DEPTH`
+    pthread_t thread;
+} PushThread;
+
+static double now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+/**
+ * Pushes what is due every `WORKER_BENCH_PACE_MS` until the stage ends, spreading events over every tank and
+ * alternating low and full per round of tanks.
+ *
+ * @param[in,out] arg  Pointer to the `PushThread`.
+ * @return             NULL.
+ */
+static void *push_thread(void *arg) {
+    PushThread *push = (PushThread *)arg;
+    Manager *manager = push->manager;
+    double start = now_ms();
+    Event event;
+
+    while (now_ms() < push->stage_end && !push->overflowed) {
+        long due = (long)((now_ms() - start) * push->per_ms);
+        while (push->pushed < due) {
+            if (__atomic_load_n(&manager->event_queue.size, __ATOMIC_RELAXED) >= WORKER_BENCH_MAX_DEPTH) {
+                push->overflowed = 1;
+                break;
+            }
+            long i = push->index + push->pushed * 7;   // 7 is coprime with RESOURCES, so every tank is visited
+            Resource *tank = manager->resource_array.resources[1 + i % RESOURCES];
+            int status = ((i / RESOURCES) & 1) ? STATUS_CAPACITY : STATUS_LOW;
+            event_init(&event, tank->producers[0], tank, status, PRIORITY_HIGH, 0);
+            event_queue_push(&manager->event_queue, &event);
+            push->pushed++;
+        }
+        usleep(WORKER_BENCH_PACE_MS * 1000);
+    }
+    return NULL;
+}
+
+/**
+ * Event hook of the manager: counts the events dispatched.
+ */
+static void count_event(void *context, const Event *event) {
+    (void)event;
+    (*(long *)context)++;
+}
+
+/**
+ * Runs one stage at `rate` events per second.
+ *
+ * @param[out] handled_rate  Events handled per second.
+ * @return                   Non-zero if the manager could not keep up.
+ */
+static int run_stage(Manager *manager, PushThread *threads, int producers, double rate, double stage_ms,
+                     double *handled_rate) {
+    long handled = 0, pushed = 0, ticks = 0;
+    int overflowed = 0;
+    Event event;
+
+    manager->event_hook = count_event;
+    manager->event_hook_context = &handled;
+    double start = now_ms();
+    for (int p = 0; p < producers; p++) {
+        threads[p].per_ms = rate / 1000.0 / producers;
+        threads[p].stage_end = start + stage_ms;
+        threads[p].pushed = 0;
+        threads[p].overflowed = 0;
+        pthread_create(&threads[p].thread, NULL, push_thread, &threads[p]);
+    }
+    while (now_ms() < start + stage_ms) {
+        manager_run(manager);
+        usleep(MANAGER_WAIT_TIME * 1000);
+        ticks++;
+    }
+    double elapsed = now_ms() - start;
+    for (int p = 0; p < producers; p++) {
+        pthread_join(threads[p].thread, NULL);
+        pushed += threads[p].pushed;
+        overflowed |= threads[p].overflowed;
+    }
+    manager->event_hook = NULL;
+    int backlog = manager->event_queue.size;
+    while (event_queue_pop(&manager->event_queue, &event)) {
+        // Drop what is left, the next stage starts from an empty queue
+    }
+
+    double offered = pushed / elapsed * 1000.0;
+    double tick_ms = ticks > 0 ? elapsed / ticks : stage_ms;
+    *handled_rate = handled / elapsed * 1000.0;
+    return overflowed || *handled_rate < 0.9 * offered || offered < 0.9 * rate ||
+           backlog > 2.0 * offered * tick_ms / 1000.0 + 1;
+}
+
+/**
+ * Doubles the rate from `rate` until the manager with `workers` workers saturates, and prints one row.
+ */
+static void run_configuration(int workers, int producers, double rate, double max_rate, double stage_ms) {
+    Manager manager;
+    Resource *source;
+    ResourceAmount consume_source, produce;
+    PushThread threads[WORKER_BENCH_MAX_PRODUCERS];
+
+    manager_init(&manager);
+    manager.display_enabled = 0;
+    resource_create(&source, "Source", 1000, 1000);
+    resource_array_add(&manager.resource_array, source);
+    resource_amount_init(&consume_source, source, 1);
+    for (int r = 0; r < RESOURCES; r++) {
+        Resource *tank;
+        resource_create(&tank, "Tank", 500, 1000);
+        resource_array_add(&manager.resource_array, tank);
+        resource_amount_init(&produce, tank, 1);
+        for (int p = 0; p < PRODUCERS_PER_RESOURCE; p++) {
+            System *producer;
+            system_create(&producer, "Pump", consume_source, produce, 1, &manager.event_queue);
+            system_array_add(&manager.system_array, producer);
+        }
+    }
+    for (int p = 0; p < producers; p++) {
+        threads[p].manager = &manager;
+        threads[p].index = p;
+    }
+
+    manager_start_workers(&manager, workers);
+    double sustained = 0.0, sustained_handled = 0.0, handled;
+    for (; rate <= max_rate; rate *= 2) {
+        if (run_stage(&manager, threads, producers, rate, stage_ms, &handled)) {
+            break;
+        }
+        sustained = rate;
+        sustained_handled = handled;
+    }
+    manager_stop_workers(&manager);
+
+    if (rate <= max_rate) {
+        printf("%-8d %14.0f %14.0f %14.0f\n", workers, sustained, sustained_handled, rate);
+    } else {
+        printf("%-8d %14.0f %14.0f %14s\n", workers, sustained, sustained_handled, "-");
+    }
+
+    manager_clean(&manager);
+}
+
+int main(int argc, char *argv[]) {
+    int worker_counts[] = {0, 1, 2, 4, 8};
+    int producers = 2;
+    double rate = 20000.0, max_rate = 20000000.0, stage_ms = 500.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--producers") == 0 && i + 1 < argc) {
+            producers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-rate") == 0 && i + 1 < argc) {
+            max_rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--stage") == 0 && i + 1 < argc) {
+            stage_ms = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (producers < 1 || producers > WORKER_BENCH_MAX_PRODUCERS || rate <= 0.0 || stage_ms <= 0.0) {
+        fprintf(stderr, "Invalid settings\n");
+        return 1;
+    }
+
+    printf("%d resources x %d producers, %d pushing threads, %.0f ms stages, %ld processors online\n", RESOURCES,
+           PRODUCERS_PER_RESOURCE, producers, stage_ms, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-8s %14s %14s %14s\n", "workers", "sustained/s", "handled/s", "saturated at");
+    for (unsigned i = 0; i < sizeof(worker_counts) / sizeof(worker_counts[0]); i++) {
+        run_configuration(worker_counts[i], producers, rate, max_rate, stage_ms);
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Allocation accounting, enabled at build time with ALLOC_TRACKING (e.g. `make alloc-check`).
+// Every malloc, calloc, aligned_alloc and strdup of the simulation is then routed through a wrapper recording
+// calls and bytes per call site; once the warm-up set with `alloc_tracking_start` has passed, each call site
+// which still allocates is reported as it happens. Without ALLOC_TRACKING the allocator is called directly.
+// The system headers are included first, so the macros below never rename their declarations.
+
+#define ALLOC_MAX_SITES 512   // Call sites the table can hold, later sites are counted together as "other"
+
+void *alloc_track_malloc(size_t size, const char *file, int line);
+void *alloc_track_calloc(size_t count, size_t size, const char *file, int line);
+void *alloc_track_aligned_alloc(size_t alignment, size_t size, const char *file, int line);
+char *alloc_track_strdup(const char *string, const char *file, int line);
+int alloc_tracking_enabled(void);
+void alloc_tracking_start(double warmup_ms);
+long alloc_tracking_report(FILE *stream);
+
+#if defined(ALLOC_TRACKING) && !defined(ALLOC_IMPLEMENTATION)
+#define malloc(size) alloc_track_malloc((size), __FILE__, __LINE__)
+#define calloc(count, size) alloc_track_calloc((count), (size), __FILE__, __LINE__)
+#define aligned_alloc(alignment, size) alloc_track_aligned_alloc((alignment), (size), __FILE__, __LINE__)
+#define strdup(string) alloc_track_strdup((string), __FILE__, __LINE__)
+#endif
+
+#endif
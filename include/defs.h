@@ -1,4 +1,11 @@
+#include "lock.h"
+#include "alloc.h"
+#include "policy.h"
+#include <pthread.h>
 #include <semaphore.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
 
 // Allow us to do some formatting in the terminal
 // Such as clearing the line before printing or moving the location of the "cursor" that will print.
@@ -26,19 +33,97 @@
 #define MANAGER_WAIT_TIME 5         // Milliseconds for the manager to wait between popping the queue
 #define SYSTEM_WAIT_TIME 20         // Milliseconds between loops of the system when production cannot occur
 
+#define DIST_CONSTANT    0  // Processing time is exactly `processing_time`
+#define DIST_UNIFORM     1  // Uniform in [processing_time - spread, processing_time + spread]
+#define DIST_NORMAL      2  // Normal with mean `processing_time` and standard deviation `spread`
+#define DIST_EXPONENTIAL 3  // Exponential with mean `processing_time`
+
+#define DEFAULT_SEED 0x5eed  // Seed used for the random streams when none is given
+
+#define BACKOFF_FIXED    0      // Sleep SYSTEM_WAIT_TIME after every failed attempt
+#define BACKOFF_ADAPTIVE 1      // Yield for a few attempts, then sleep exponentially longer, reset on success
+#define BACKOFF_PARK     2      // Leave the scheduler on the resource's waiter list until it reaches the level needed
+#define BACKOFF_QUEUE    3      // Park in weight then arrival order, a refill hands the input to the head of the queue
+#define BACKOFF_SPIN_ATTEMPTS 32   // Retries which only yield the processor before the adaptive backoff starts sleeping
+#define BACKOFF_MIN_WAIT 250       // Microseconds of the first adaptive sleep
+#define BACKOFF_MAX_WAIT 100000    // Microseconds the adaptive sleep is capped at
+#define SYSTEM_DEFAULT_WEIGHT 1    // Weight of a system on waiter queues unless set with `--weight`
+#define SYSTEM_MAX_OVERTAKES 4     // Heavier systems a queued system lets pass before it keeps its place
+
+#define FORECAST_TAU 50.0        // Milliseconds over which the flow rate estimate forgets old samples
+#define FORECAST_HORIZON 100.0   // Milliseconds ahead of a predicted empty/full crossing at which the manager acts
+
 #define PRIORITY_HIGH 3
 #define PRIORITY_MED 2
 #define PRIORITY_LOW 1
+#define PRIORITY_LEVELS 4  // Number of distinct priority bands kept by the `EventQueue` (0 to PRIORITY_HIGH)
+#define EVENT_NODES_PER_SYSTEM 2  // Queue nodes allocated per system before the threads start
+
+#define CACHE_LINE_SIZE 64   // Bytes in a cache line, used to keep data written by one thread away from others
+#define CONTROL_NONE -1      // Control word value letting each producer follow its own status
+
+// Speed shared by every producer of a resource, on a cache line of its own so a write by the manager
+// only invalidates the line the producers read, never the resource amounts they update
+typedef struct ResourceControl {
+    int status;   // SLOW, STANDARD or FAST applied to all producers, or CONTROL_NONE
+} __attribute__((aligned(CACHE_LINE_SIZE))) ResourceControl;
 
 // Represents the resource amounts for the entire rocket
 typedef struct Resource {
     char *name;      // Dynamically allocated string
+    int id;          // Index of the resource in the `ResourceArray`
     int amount;
     int max_capacity;
+    int reserved;    // Capacity promised to systems mid-cycle in reserve mode, not available to other producers
+    long produced;   // Units stored by systems since creation, updated under the lock with `amount`
+    long consumed;   // Units taken by systems since creation, so initial + produced - consumed == amount
+    struct System **producers;  // Systems producing this resource, so the manager can reach them without scanning every system
+    int producer_count;
+    int producer_capacity;
+    double flow_rate;           // Smoothed net change (production minus consumption) in units per millisecond
+    double last_sample_time;    // Manager clock when the flow rate was last updated, negative before the first sample
+    int last_sample_amount;     // Amount at that time
+    int forecast_status;        // Speed the forecast last gave the producers, STANDARD when no crossing is forecast
+    ResourceControl *control;   // Group speed of the producers, written by the manager in group control mode
+    struct System *waiters;     // Systems parked until this resource reaches their level, linked through `next_waiter`
+    int waiter_count;
+    int queued_inputs;          // BACKOFF_QUEUE systems waiting for input, which other consumers may not overtake
+    int promised;               // Units set aside for reserve mode consumers woken from the queue, not yet taken
+    int promised_space;         // Free space set aside for producers woken from the queue, not yet used
 
-    sem_t lock;
+    Lock lock;
 } Resource;
 
+// State of a xoshiro256** pseudo-random generator, each system owns one so no locking is needed
+typedef struct Rng {
+    uint64_t state[4];
+} Rng;
+
+// Counters describing how a system spent its time, only written by the thread running the system
+typedef struct SystemMetrics {
+    long cycles;          // Inputs successfully consumed
+    long failed_cycles;   // Attempts to consume which found too little input
+    long failed_stores;   // Attempts to store (or to reserve space, in reserve mode) which found the output at capacity
+    long retries;         // Failed steps which had to be retried
+    long spins;           // Retries which only yielded the processor
+    long sleeps;          // Retries which slept
+    long events;          // Events sent to the manager
+    long parks;           // Retries which parked on the resource instead (BACKOFF_PARK or BACKOFF_QUEUE)
+    long handoffs;        // Cycles whose input a refill handed over while the system was queued (BACKOFF_QUEUE)
+    long lost_races;      // Parked retries which failed again right after waking (BACKOFF_PARK or BACKOFF_QUEUE)
+    double parked_ms;     // Time spent parked
+} SystemMetrics;
+
+// Holds the simulation's threads at a safe point while the control socket has paused it.
+// Threads pass it with `pause_gate_pass`, which is a single load while the gate is open
+typedef struct PauseGate {
+    int closed;             // non-zero while paused
+    long step_ticks;        // Manager ticks left before the gate closes again, zero when not stepping
+    int held;               // Threads waiting at the gate
+    pthread_mutex_t mutex;
+    pthread_cond_t changed; // Broadcast when the gate opens or closes, or a thread arrives at it
+} PauseGate;
+
 // Represents the amount of a resource consumed/produced for a single system
 typedef struct ResourceAmount {
     Resource *resource;
@@ -48,11 +133,37 @@ typedef struct ResourceAmount {
 // A system which consumes resources, waits for `processing_time` milliseconds, then produced the produced resource
 typedef struct System {
     char *name;     // Dynamically allocated string
+    int id;         // Index of the system in the `SystemArray`
     ResourceAmount consumed;
     ResourceAmount produced;
     int amount_stored;
     int processing_time;
+    int distribution;   // One of the DIST_ values, how `processing_time` varies from cycle to cycle
+    double spread;      // Parameter of the distribution (half-width for uniform, standard deviation for normal)
+    Rng rng;            // Random stream used only by this system's thread
     int status; 
+    int backoff_strategy;       // BACKOFF_FIXED, BACKOFF_ADAPTIVE, BACKOFF_PARK or BACKOFF_QUEUE, how failed steps are retried
+    int weight;                 // Heavier systems are served first on waiter queues (BACKOFF_QUEUE)
+    int consecutive_failures;   // Failed steps since the last success
+    long unreported_wait;       // Microseconds slept by the adaptive backoff since its last event
+    int reserve_output;         // non-zero to reserve output space when consuming, so a started cycle always stores
+    int silent;                 // non-zero to send no events, when the manager scans resource thresholds instead
+    int multiplicity;           // Number of identical systems this one stands for, each cycle does the work of all of them
+    int active_copies;          // Copies whose input was taken by the current cycle (at most `multiplicity`)
+    int parked;                 // non-zero if the system can never run and was left without a thread
+    Resource *waiting_on;       // Resource whose waiter list holds the system, NULL while it is scheduled
+    int wait_level;             // Amount (or free space, with `wait_for_space`) the system is waiting for
+    int wait_for_space;         // non-zero if waiting for room to store, zero if waiting for input
+    struct System *next_waiter; // Next system on the same waiter list
+    int granted_copies;         // Copies whose input was handed over while queued, taken by the next consume
+    int promised_input;         // Input set aside for the system when it was woken from a queue in reserve mode,
+                                // taken by its next attempt, which may pass the systems still queued
+    int promised_space;         // Space set aside for the system when it was woken from a queue, used by its next store
+    int overtaken;              // Heavier systems queued ahead of this one since it parked
+    struct Journal *journal;    // Journal recording the system's changes, NULL when not recording
+    PauseGate *gate;            // Gate passed before every cycle, NULL to run without one
+    sem_t wake;                 // Posted when the system is taken off the waiter list
+    SystemMetrics metrics;
     struct EventQueue *event_queue;  // Pointer to event queue shared by all systems and manager
 } System;
 
@@ -71,12 +182,14 @@ typedef struct EventNode {
     struct EventNode *next;
 } EventNode;
 
-// Linked List structure with a head and no tail, single instance shared by all systems
+// Linked List structure with a head and the tail of each priority band, single instance shared by all systems
 typedef struct EventQueue {
     EventNode *head;
+    EventNode *tails[PRIORITY_LEVELS];  // Last node of each priority band, NULL if the band is empty
+    EventNode *free_nodes;              // Popped nodes kept for reuse, so steady-state pushes do not allocate
     int size;
 
-    sem_t lock;
+    Lock lock;
 } EventQueue;
 
 // A basic dynamic array to store all of the systems in the simulation
@@ -93,9 +206,300 @@ typedef struct ResourceArray {
     int capacity;
 } ResourceArray;
 
+#define STATE_CHUNK_SIZE 64         // Number of values held by each shared chunk of a `PersistentArray`
+
+// A fixed-size block of values which may be shared between several snapshots
+typedef struct PersistentChunk {
+    int refs;       // Number of tables pointing at this chunk
+    int values[STATE_CHUNK_SIZE];
+} PersistentChunk;
+
+// The table of chunk pointers for a `PersistentArray`, shared until one of its owners writes
+typedef struct PersistentTable {
+    int refs;       // Number of arrays pointing at this table
+    int chunk_count;
+    PersistentChunk **chunks;
+} PersistentTable;
+
+// A copy-on-write array of integers, snapshots share all memory until they are modified
+typedef struct PersistentArray {
+    PersistentTable *table;
+    int size;
+} PersistentArray;
+
+// The mutable part of a simulation (resource amounts and system state), cheap to snapshot and branch
+typedef struct SimState {
+    PersistentArray resource_amounts;
+    PersistentArray system_stored;
+    PersistentArray system_status;
+} SimState;
+
+// Continuous approximation of the simulation: systems are rate processes and resource levels are integrated with RK4
+// Stored as parallel arrays so each pass over systems or resources is a simple loop the compiler can vectorize
+typedef struct FlowModel {
+    int system_count;
+    int resource_count;
+    double time;             // Simulated milliseconds since the model was created
+
+    // Per system
+    int *consumed_ids;       // Id of the consumed resource, -1 if none
+    int *produced_ids;       // Id of the produced resource, -1 if none
+    double *consumed_units;  // Units consumed per cycle
+    double *produced_units;  // Units produced per cycle
+    double *cycle_rates;     // Cycles per millisecond at STANDARD speed
+    double *speeds;          // Speed multiplier from the system's status, refreshed every step
+    double *activity;        // Scratch: cycles per millisecond at the current stage
+
+    // Per resource
+    double *levels;
+    double *capacities;
+    int *level_status;       // Last threshold status reported for the resource (STATUS_OK when none)
+    int *first_consumer;     // Id of a system consuming the resource, -1 if none (used as the event source)
+    int *first_producer;     // Id of a system producing the resource, -1 if none
+    double *stage;           // Scratch: levels used to evaluate the current RK4 stage
+    double *k[4];            // Scratch: RK4 derivatives
+} FlowModel;
+
+#define STEP_WAITING_INPUT 0   // The system is about to take the input of its next cycle
+#define STEP_PROCESSING    1   // The system has taken its input and is waiting for its processing time to pass
+#define STEP_STORING       2   // The system is trying to store its output
+#define STEP_MIN_DELAY     0.001  // Smallest virtual time (milliseconds) a cycle may take, so time always advances
+
+// Runs the systems and the manager in virtual time on the calling thread, without threads or sleeps
+typedef struct Stepper {
+    double time;               // Virtual milliseconds simulated so far
+    double next_manager_time;  // Virtual time at which the manager next handles its events
+    int count;                 // Number of systems being scheduled
+    int *heap;                 // System ids in a binary min-heap ordered by `next_times`
+    double *next_times;        // Virtual time of each system's next action
+    int *phases;               // STEP_ phase of each system
+} Stepper;
+
+#define JOURNAL_RESOURCE 0   // Record of a resource amount
+#define JOURNAL_STORED   1   // Record of the output held by a system
+#define JOURNAL_STATUS   2   // Record of a system status
+#define JOURNAL_KIND_BITS 2  // Low bits of `JournalRecord.kind_id` holding the JOURNAL_ kind, the id is above them
+#define JOURNAL_BUFFER_RECORDS 4096        // Records buffered in memory before they are written out
+#define JOURNAL_SNAPSHOT_INTERVAL 1000.0   // Milliseconds between full snapshots, bounds the records replayed by a seek
+
+// One change in a journal, 12 bytes. Values are absolute (the new amount or status, not a difference),
+// so a snapshot taken while systems are running stays consistent with the records around it
+typedef struct JournalRecord {
+    uint32_t offset_us;   // Microseconds since the snapshot preceding the record
+    uint32_t kind_id;     // JOURNAL_ kind in the low `JOURNAL_KIND_BITS`, resource or system id above them
+    int32_t value;
+} JournalRecord;
+
+// Position of one snapshot in the journal file, the index of all of them is written as a footer
+typedef struct JournalIndexEntry {
+    double time;          // Milliseconds since the journal was opened
+    int64_t offset;       // Byte offset of the snapshot in the file
+} JournalIndexEntry;
+
+// Append-only binary log of every consume, store and status change, with periodic full snapshots.
+// File layout: header, then snapshot and record frames in time order, then the snapshot index and a trailer
+typedef struct Journal {
+    FILE *file;
+    Lock lock;                  // Serializes appends from all system threads and the manager
+    struct timespec start;      // Wall clock origin of the journal time
+    int virtual_time;           // non-zero to take the time from `time`, set by whatever drives the simulation
+    double time;                // Current time in milliseconds when `virtual_time` is set
+    double snapshot_time;       // Time of the latest snapshot, records are stored relative to it
+    int resource_count;
+    int system_count;
+    JournalRecord *buffer;      // Records not yet written out
+    int buffered;
+    JournalIndexEntry *index;   // Every snapshot written so far
+    int index_count;
+    int index_capacity;
+    long records;               // Records written since the journal was opened
+    int failed;                 // non-zero once a write has failed
+} Journal;
+
+// One event handed to the manager, 24 bytes; systems and resources are stored by id
+typedef struct TraceRecord {
+    double time;          // Manager clock in milliseconds
+    int32_t system;
+    int32_t resource;
+    int16_t status;
+    int16_t priority;
+    int32_t amount;
+} TraceRecord;
+
+// Recording of the events seen by the manager, to replay them offline through its decision code
+typedef struct Trace {
+    FILE *file;
+    long records;         // Events written since the trace was opened
+    int failed;           // non-zero once a write has failed
+} Trace;
+
+// Results of `trace_replay`
+typedef struct TraceReplay {
+    long events;
+    int rounds;
+    double best_ms;       // Fastest timed replay of all the events
+    double total_ms;      // All timed replays together
+    long changes;         // System speed changes caused by the events
+    long terminated_at;   // Index of the event which stopped the simulation, -1 if none did
+    uint64_t digest;      // Hash of every change, equal for policies which made the same decisions
+} TraceReplay;
+
+#define SCAN_WORD_BITS 64   // Resources covered by one word of a `ThresholdScan` bitmask
+
+#define SCAN_EMPTY 0   // Bitmask of resources with nothing left
+#define SCAN_LOW   1   // Bitmask of resources below THRESHOLD_RESOURCE_LOW
+#define SCAN_FULL  2   // Bitmask of resources at capacity
+#define SCAN_MASKS 3
+
+// Lets the manager find resources needing action by comparing every amount against its thresholds each tick,
+// instead of waiting for systems to report failures. Arrays are padded to a whole number of words with
+// thresholds that never trigger, so the compare loop has no remainder
+typedef struct ThresholdScan {
+    int count;                      // Number of resources scanned
+    int system_count;               // Number of systems when the scan was built, it is rebuilt when either changes
+    int words;                      // Words in each bitmask
+    int use_simd;                   // non-zero to compare with AVX2, set when the processor supports it
+    int *amounts;                   // Contiguous copy of the resource amounts, refreshed before each compare
+    int *empty_below;               // Amount under which a resource is empty (INT_MIN if nothing consumes it)
+    int *low_below;                 // Amount under which a resource is low (INT_MIN if nothing consumes it)
+    int *full_above;                // Amount over which a resource is full (INT_MAX if nothing produces it)
+    uint64_t *masks[SCAN_MASKS];    // Resources currently in each SCAN_ state
+    uint64_t *previous[SCAN_MASKS]; // The same masks at the previous tick, only newly set bits are acted on
+    System **consumers;             // A system consuming each resource, the source of its low and empty events
+    System **producers;             // A system producing each resource, the source of its full events
+} ThresholdScan;
+
+#define PROFILE_SYSTEM  0   // Samples taken on a system thread
+#define PROFILE_MANAGER 1   // Samples taken on the manager thread (or the main thread in continuous mode)
+#define PROFILE_DISPLAY 2   // Samples taken while the manager draws the display
+#define PROFILE_WORKER  3   // Samples taken on a manager worker
+#define PROFILE_ROLES   4
+#define PROFILER_DEFAULT_HZ 1000     // Samples per second of CPU time of each thread
+#define PROFILER_MAX_HZ 100000       // Highest rate accepted, a sample every 10 us of CPU time
+#define PROFILER_MAX_SAMPLES 65536   // Samples kept, later ones are counted as dropped
+#define PROFILER_MAX_DEPTH 32        // Frames kept per sample
+
+// One stack captured by the SIGPROF handler
+typedef struct ProfileSample {
+    int role;                           // PROFILE_ role of the thread when the sample was taken
+    int depth;                          // Frames in `frames`, innermost first
+    void *frames[PROFILER_MAX_DEPTH];
+} ProfileSample;
+
+// In-process sampling profiler. Each registered thread gets a timer on its own CPU clock which sends it SIGPROF;
+// the handler only copies the stack into a preallocated slot, everything else happens when the profile is written
+typedef struct Profiler {
+    int hz;
+    ProfileSample *samples;     // Preallocated, so the signal handler never allocates
+    int capacity;
+    int count;                  // Slots claimed so far, may exceed `capacity` once samples are dropped
+    int unsampled;              // Threads whose timer could not be created or armed
+} Profiler;
+
+#define POLICY_INITIAL_EVENTS 64      // Events a policy batch holds before it first grows
+#define POLICY_DECISIONS_PER_EVENT 2  // Decisions a policy may return per event of the batch
+
+// A policy plugin loaded with dlopen, with the batch of events and the snapshot handed to it each manager tick
+typedef struct PolicyPlugin {
+    void *handle;                   // From dlopen
+    const Policy *policy;
+    void *context;                  // Returned by the policy's `create`
+    PolicyState state;
+    PolicyResource *resources;      // Storage of `state`, refreshed before each decision
+    PolicySystem *systems;
+    int resource_capacity;
+    int system_capacity;
+    PolicyEvent *events;            // Batch collected since the last decision
+    int event_count;
+    int event_capacity;
+    PolicyDecision *decisions;      // `event_capacity * POLICY_DECISIONS_PER_EVENT` entries
+    long batches;
+    long applied;                   // Decisions applied by the manager
+    long rejected;                  // Decisions with an unknown kind, id or status
+} PolicyPlugin;
+
+#define CONTROL_LINE_SIZE 256      // Longest command accepted on the control socket
+#define CONTROL_PAUSE_TIMEOUT 1000 // Milliseconds `pause` waits for the threads to reach the gate
+
+// Unix domain socket serving pause, resume, step, query and checkpoint commands on its own thread,
+// so clients never hold up the manager; one client is served at a time
+typedef struct Control {
+    struct Manager *manager;
+    char path[108];             // Socket path, the size of `sun_path`
+    int listen_fd;
+    pthread_t thread;
+    int stopping;               // non-zero once the thread should exit
+} Control;
+
+#define DASHBOARD_FRAME_MS 100      // Milliseconds between two frames of changes sent to the dashboard
+#define DASHBOARD_MAX_CLIENTS 8     // Browsers streaming at once
+#define DASHBOARD_REQUEST_SIZE 1024 // Longest HTTP request header read
+#define DASHBOARD_INITIAL_BUFFER 4096
+
+// Localhost HTTP server streaming the simulation to a browser with server-sent events.
+// Its thread samples the amounts and speeds every `DASHBOARD_FRAME_MS` and sends only those which changed,
+// so the manager does no display work and the traffic is bounded by the frame rate
+typedef struct Dashboard {
+    struct Manager *manager;
+    int port;                   // Port bound on 127.0.0.1
+    int listen_fd;
+    int clients[DASHBOARD_MAX_CLIENTS]; // Event streams, -1 for a free slot
+    int resource_count;         // Resources and systems when the dashboard started
+    int system_count;
+    int *amounts;               // Snapshot the clients were last sent, per resource
+    int *speeds;                // and per system
+    int *stored;
+    char *buffer;               // Message being built, grown by doubling
+    size_t length;
+    size_t capacity;
+    long frames;                // Frames which carried changes
+    long bytes;                 // Bytes streamed to all clients
+    long dropped;               // Clients dropped because they could not keep up
+    pthread_t thread;
+    int stopping;               // non-zero once the thread should exit
+} Dashboard;
+
+#define WORKER_RING_SIZE 1024   // Events a manager worker can have pending, must be a power of two
+
+// Applies the manager's status decisions for the resources whose id maps to it, in parallel with the other workers.
+// Events reach it through a ring with a single producer (the manager thread) and a single consumer (the worker),
+// so the events of each resource are applied in the order the manager popped them
+typedef struct ManagerWorker {
+    struct Manager *manager;
+    pthread_t thread;
+    sem_t wake;                     // Posted when events are added or the worker must stop
+    int stopping;                   // non-zero once the worker should exit after applying its pending events
+    Event ring[WORKER_RING_SIZE];
+    unsigned long pushed __attribute__((aligned(CACHE_LINE_SIZE)));   // Events added, written by the manager thread
+    unsigned long handled __attribute__((aligned(CACHE_LINE_SIZE)));  // Events applied, written by the worker
+} __attribute__((aligned(CACHE_LINE_SIZE))) ManagerWorker;
+
 // Container structure which contains all of the core data for our simulation
 typedef struct Manager {
     int simulation_running; // non-zero if the simulation is running, zero if it should be stopped
+    uint64_t seed;          // Seed from which every system's random stream is derived
+    int display_enabled;    // non-zero to draw the simulation state and events in the terminal
+    int predictive;         // non-zero to change producer speeds ahead of forecast empty/full crossings
+    double clock;           // Milliseconds of simulated time, set by whatever drives the manager before each `manager_run`
+    long proactive_switches; // Speed changes made because of a forecast
+    int waiting_count;      // Systems parked on a resource's waiter list at the last manager tick
+    int waiting_peak;       // Most systems parked on waiter lists at any manager tick
+    int scan;               // non-zero to find resources needing action with a threshold scan instead of events
+    int group_control;      // non-zero to change producer speeds through the resource control word, not per system
+    ThresholdScan threshold_scan;
+    Journal *journal;       // Journal recording status changes and snapshots, NULL when not recording
+    Trace *trace;           // Trace recording every event handled, NULL when not recording
+    PolicyPlugin *policy;   // Plugin deciding instead of `manager_handle_event`, NULL for the built-in policy
+    void (*event_hook)(void *context, const Event *event); // Called with every event dispatched, NULL for none
+    void *event_hook_context;
+    int worker_count;       // Workers applying speed changes in parallel, zero to apply them on the manager thread
+    ManagerWorker *workers;
+    int parked_count;       // Systems currently parked because nothing can ever feed them
+    pthread_t *system_threads;  // Thread of each system, indexed by id
+    int *system_thread_started; // non-zero where `system_threads` holds a thread to join
+    int system_thread_capacity; // Length of both arrays
+    int threads_running;    // non-zero between `manager_start_threads` and `manager_join_threads`
+    PauseGate gate;         // Closed by the control socket to pause the system threads and the manager
     SystemArray system_array;
     ResourceArray resource_array;
     EventQueue event_queue;
@@ -105,25 +509,63 @@ typedef struct Manager {
 void manager_init(Manager *manager);
 void manager_clean(Manager *manager);
 void manager_run(Manager *manager);
+void manager_handle_event(Manager *manager, const Event *event);
+void manager_handle_events(Manager *manager, const Event *events, int count);
+void manager_forecast(Manager *manager);
+void manager_seed(Manager *manager, uint64_t seed);
+void manager_print_metrics(Manager *manager);
+void manager_scan(Manager *manager);
+int manager_aggregate(Manager *manager);
+int manager_prune(Manager *manager);
+void manager_add_system(Manager *manager, System *system);
+void manager_start_threads(Manager *manager);
+void manager_join_threads(Manager *manager);
+void manager_start_workers(Manager *manager, int count);
+void manager_stop_workers(Manager *manager);
+void manager_dispatch_event(Manager *manager, const Event *event);
 
 // System functions
 void system_create(System **system, const char *name, ResourceAmount consumed, ResourceAmount produced, int processing_time, EventQueue *event_queue);
 void system_destroy(System *system);
 void system_run(System *system);
+void system_report(System *system, Resource *resource, int status, int priority);
+int system_consume(System *system);
+int system_store_resources(System *system);
+int system_consume_reserved(System *system);
+void system_commit_reserved(System *system);
+double system_processing_delay(System *system);
+int system_speed(const System *system);
+void system_set_distribution(System *system, int distribution, double spread);
+double system_sample_processing_time(System *system);
 
 // Resource functions
 void resource_create(Resource **resource, const char *name, int amount, int max_capacity);
 void resource_destroy(Resource *resource);
+void resource_add_producer(Resource *resource, struct System *system);
+int resource_park(Resource *resource, struct System *system);
+void resource_wake_waiters(Resource *resource);
+void resource_wake_all(Resource *resource);
+void resource_forecast_update(Resource *resource, double now);
+double resource_time_to_empty(const Resource *resource);
+double resource_time_to_full(const Resource *resource);
 
 // ResourceAmount functions
 void resource_amount_init(ResourceAmount *resource_amount, Resource *resource, int amount);
 
+// Rng functions
+void rng_seed(Rng *rng, uint64_t seed, uint64_t stream);
+uint64_t rng_next(Rng *rng);
+double rng_uniform(Rng *rng);
+double rng_normal(Rng *rng);
+double rng_exponential(Rng *rng);
+
 // Event functions
 void event_init(Event *event, System *system, Resource *resource, int status, int priority, int amount);
 
 // EventQueue functions
 void event_queue_init(EventQueue *queue);
 void event_queue_clean(EventQueue *queue);
+void event_queue_reserve(EventQueue *queue, int count);
 void event_queue_push(EventQueue *queue, const Event *event); 
 int event_queue_pop(EventQueue *queue, Event* event);
 
@@ -136,5 +578,85 @@ void resource_array_init(ResourceArray *array);
 void resource_array_clean(ResourceArray *array);
 void resource_array_add(ResourceArray *array, Resource *resource);
 
+// PersistentArray functions
+void persistent_array_init(PersistentArray *array, int size);
+void persistent_array_clean(PersistentArray *array);
+void persistent_array_snapshot(const PersistentArray *source, PersistentArray *snapshot);
+int persistent_array_get(const PersistentArray *array, int index);
+void persistent_array_set(PersistentArray *array, int index, int value);
+
+// SimState functions
+void sim_state_capture(SimState *state, Manager *manager);
+void sim_state_snapshot(const SimState *source, SimState *snapshot);
+void sim_state_restore(const SimState *state, Manager *manager);
+void sim_state_clean(SimState *state);
+int sim_state_cycle(SimState *state, const Manager *manager, int system_id);
+
+// Journal functions
+int journal_open(Journal *journal, const char *path, Manager *manager);
+int journal_close(Journal *journal);
+double journal_now(Journal *journal);
+void journal_record(Journal *journal, int kind, int id, int value);
+void journal_snapshot(Journal *journal, Manager *manager);
+int journal_seek(const char *path, double time, SimState *state, double *snapshot_time, long *replayed);
+
+// Policy functions
+int policy_load(PolicyPlugin *plugin, const char *path, Manager *manager, const char **error);
+void policy_unload(PolicyPlugin *plugin);
+void policy_add_event(PolicyPlugin *plugin, const Event *event);
+int policy_decide(PolicyPlugin *plugin, Manager *manager);
+
+// Trace functions
+int trace_open(Trace *trace, const char *path, Manager *manager);
+int trace_close(Trace *trace);
+void trace_record(Trace *trace, double time, const Event *event);
+int trace_load(const char *path, Manager *manager, Event **events, double **times, long *count);
+void trace_replay(Manager *manager, const Event *events, const double *times, long count, int rounds, TraceReplay *replay);
+
+// Control functions
+void pause_gate_init(PauseGate *gate);
+void pause_gate_clean(PauseGate *gate);
+int pause_gate_pass(PauseGate *gate);
+void pause_gate_tick(PauseGate *gate);
+void pause_gate_close(PauseGate *gate);
+void pause_gate_open(PauseGate *gate, long step_ticks);
+int control_start(Control *control, const char *path, Manager *manager);
+void control_stop(Control *control);
+
+// Dashboard functions
+int dashboard_start(Dashboard *dashboard, int port, Manager *manager);
+void dashboard_stop(Dashboard *dashboard);
+
+// Profiler functions
+int profiler_start(Profiler *profiler, int hz);
+void profiler_stop(Profiler *profiler);
+void profiler_thread_start(int role);
+void profiler_thread_stop(void);
+int profiler_set_role(int role);
+int profiler_write_folded(Profiler *profiler, const char *path);
+
+// FlowModel functions
+void flow_model_init(FlowModel *model, Manager *manager);
+void flow_model_clean(FlowModel *model);
+void flow_model_step(FlowModel *model, Manager *manager, double dt);
+void flow_model_sync(FlowModel *model, Manager *manager);
+
+// Threshold scan functions
+void threshold_scan_init(ThresholdScan *scan, Manager *manager);
+void threshold_scan_clean(ThresholdScan *scan);
+void threshold_scan_gather(ThresholdScan *scan, Manager *manager);
+void threshold_scan_compare(ThresholdScan *scan);
+
+// Stepper functions
+void stepper_init(Stepper *stepper, Manager *manager);
+void stepper_resize(Stepper *stepper, Manager *manager);
+void stepper_clean(Stepper *stepper);
+void stepper_advance(Stepper *stepper, Manager *manager, double dt);
+
+// Scenario functions
+void load_data(Manager *manager);
+void load_distributions(Manager *manager);
+void load_crew(Manager *manager, int crew);
+
 void *manager_thread(void *arg);
 void *system_thread(void *arg);
\ No newline at end of file
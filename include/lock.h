@@ -0,0 +1,129 @@
+#ifndef LOCK_H
+#define LOCK_H
+
+// Lock used by `Resource` and `EventQueue`, the implementation is chosen at build time with LOCK_STRATEGY
+// (e.g. `make LOCK_STRATEGY=LOCK_FUTEX`). Every strategy offers the same four operations.
+
+#define LOCK_SEM      0   // POSIX semaphore initialized to 1 (original behaviour)
+#define LOCK_MUTEX    1   // Default pthread mutex
+#define LOCK_ADAPTIVE 2   // glibc adaptive mutex, spins briefly before sleeping
+#define LOCK_TICKET   3   // Ticket spinlock, FIFO order, yields after spinning for a while
+#define LOCK_FUTEX    4   // Spin-then-park lock built directly on futex
+
+#ifndef LOCK_STRATEGY
+#define LOCK_STRATEGY LOCK_SEM
+#endif
+
+#define LOCK_SPIN_LIMIT 100   // Spins before the ticket lock yields and the futex lock parks
+
+#if LOCK_STRATEGY == LOCK_SEM
+#include <semaphore.h>
+typedef sem_t Lock;
+#define LOCK_NAME "sem"
+#elif LOCK_STRATEGY == LOCK_MUTEX || LOCK_STRATEGY == LOCK_ADAPTIVE
+#if LOCK_STRATEGY == LOCK_ADAPTIVE && !defined(_GNU_SOURCE)
+#error "LOCK_ADAPTIVE needs _GNU_SOURCE for PTHREAD_MUTEX_ADAPTIVE_NP, defined by the Makefile's CPPFLAGS"
+#endif
+#include <pthread.h>
+typedef pthread_mutex_t Lock;
+#define LOCK_NAME ((LOCK_STRATEGY == LOCK_MUTEX) ? "mutex" : "adaptive")
+#elif LOCK_STRATEGY == LOCK_TICKET
+#include <sched.h>
+typedef struct Lock {
+    unsigned next;      // Next ticket to hand out
+    unsigned serving;   // Ticket currently allowed in
+} Lock;
+#define LOCK_NAME "ticket"
+#elif LOCK_STRATEGY == LOCK_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+typedef struct Lock {
+    int state;          // 0 unlocked, 1 locked, 2 locked with sleepers
+} Lock;
+#define LOCK_NAME "futex"
+#else
+#error "Unknown LOCK_STRATEGY"
+#endif
+
+static inline void lock_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static inline void lock_init(Lock *lock) {
+#if LOCK_STRATEGY == LOCK_SEM
+    sem_init(lock, 0, 1);
+#elif LOCK_STRATEGY == LOCK_MUTEX
+    pthread_mutex_init(lock, NULL);
+#elif LOCK_STRATEGY == LOCK_ADAPTIVE
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_ADAPTIVE_NP);
+    pthread_mutex_init(lock, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+#elif LOCK_STRATEGY == LOCK_TICKET
+    lock->next = 0;
+    lock->serving = 0;
+#elif LOCK_STRATEGY == LOCK_FUTEX
+    lock->state = 0;
+#endif
+}
+
+static inline void lock_destroy(Lock *lock) {
+#if LOCK_STRATEGY == LOCK_SEM
+    sem_destroy(lock);
+#elif LOCK_STRATEGY == LOCK_MUTEX || LOCK_STRATEGY == LOCK_ADAPTIVE
+    pthread_mutex_destroy(lock);
+#else
+    (void)lock;
+#endif
+}
+
+static inline void lock_acquire(Lock *lock) {
+#if LOCK_STRATEGY == LOCK_SEM
+    sem_wait(lock);
+#elif LOCK_STRATEGY == LOCK_MUTEX || LOCK_STRATEGY == LOCK_ADAPTIVE
+    pthread_mutex_lock(lock);
+#elif LOCK_STRATEGY == LOCK_TICKET
+    unsigned ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    int spins = 0;
+    while (__atomic_load_n(&lock->serving, __ATOMIC_ACQUIRE) != ticket) {
+        if (++spins < LOCK_SPIN_LIMIT) {
+            lock_relax();
+        } else {
+            sched_yield();  // The holder may be descheduled, spinning any longer only delays it
+        }
+    }
+#elif LOCK_STRATEGY == LOCK_FUTEX
+    int expected = 0;
+    for (int spins = 0; spins < LOCK_SPIN_LIMIT; spins++) {
+        if (__atomic_compare_exchange_n(&lock->state, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        expected = 0;
+        lock_relax();
+    }
+    // Mark the lock contended so the holder wakes us, then sleep until it is released
+    while (__atomic_exchange_n(&lock->state, 2, __ATOMIC_ACQUIRE) != 0) {
+        syscall(SYS_futex, &lock->state, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+    }
+#endif
+}
+
+static inline void lock_release(Lock *lock) {
+#if LOCK_STRATEGY == LOCK_SEM
+    sem_post(lock);
+#elif LOCK_STRATEGY == LOCK_MUTEX || LOCK_STRATEGY == LOCK_ADAPTIVE
+    pthread_mutex_unlock(lock);
+#elif LOCK_STRATEGY == LOCK_TICKET
+    __atomic_store_n(&lock->serving, lock->serving + 1, __ATOMIC_RELEASE);
+#elif LOCK_STRATEGY == LOCK_FUTEX
+    if (__atomic_exchange_n(&lock->state, 0, __ATOMIC_RELEASE) == 2) {
+        syscall(SYS_futex, &lock->state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+#endif
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+// Interface of manager policy plugins, shared libraries loaded with `--policy FILE`.
+// A plugin exports `rocketsim_policy`, returning its `Policy`. Each manager tick the policy is given the batch
+// of events the manager received and a read-only snapshot of the simulation, and answers with status decisions,
+// which the manager applies. Plugins only include this header and do not link against the simulator.
+
+#define POLICY_API_VERSION 1
+#define POLICY_ENTRY_SYMBOL "rocketsim_policy"
+
+// Speeds and statuses, equal to the simulator's own values
+#define POLICY_TERMINATE 0
+#define POLICY_DISABLED  1
+#define POLICY_SLOW      2
+#define POLICY_STANDARD  3
+#define POLICY_FAST      4
+
+// Event statuses
+#define POLICY_STATUS_EMPTY        0
+#define POLICY_STATUS_LOW          1
+#define POLICY_STATUS_INSUFFICIENT 2
+#define POLICY_STATUS_CAPACITY     3
+
+// Kinds of decision
+#define POLICY_SET_PRODUCERS 0   // Set every producer of resource `id` to speed `status`
+#define POLICY_SET_SYSTEM    1   // Set system `id` to speed `status`
+#define POLICY_STOP          2   // Terminate the simulation, `id` and `status` are ignored
+
+// One event of the batch, with systems and resources given by id
+typedef struct PolicyEvent {
+    int system;
+    int resource;
+    int status;       // POLICY_STATUS_ value
+    int priority;
+    int amount;       // Amount of the resource when the event was sent
+} PolicyEvent;
+
+typedef struct PolicyResource {
+    const char *name;
+    int amount;
+    int max_capacity;
+    int producer_count;
+} PolicyResource;
+
+typedef struct PolicySystem {
+    const char *name;
+    int speed;        // Effective speed, including the resource's group control
+    int consumed;     // Id of the consumed resource, -1 for none
+    int produced;     // Id of the produced resource, -1 for none
+} PolicySystem;
+
+// Snapshot of the simulation taken just before `decide` is called
+typedef struct PolicyState {
+    double clock;     // Milliseconds since the run started
+    int resource_count;
+    const PolicyResource *resources;
+    int system_count;
+    const PolicySystem *systems;
+} PolicyState;
+
+typedef struct PolicyDecision {
+    int kind;         // POLICY_SET_PRODUCERS, POLICY_SET_SYSTEM or POLICY_STOP
+    int id;
+    int status;
+} PolicyDecision;
+
+typedef struct Policy {
+    int api_version;  // POLICY_API_VERSION the plugin was built with
+    const char *name;
+    // Called once when loaded, returns the plugin's own context (may be NULL)
+    void *(*create)(const PolicyState *state);
+    // Called once when unloaded
+    void (*destroy)(void *context);
+    // Writes at most `capacity` decisions for a batch of events and returns how many it wrote
+    int (*decide)(void *context, const PolicyState *state, const PolicyEvent *events, int event_count,
+                  PolicyDecision *decisions, int capacity);
+} Policy;
+
+typedef const Policy *(*PolicyEntry)(void);
+
+#endif
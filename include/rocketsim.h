@@ -0,0 +1,40 @@
+#ifndef ROCKETSIM_H
+#define ROCKETSIM_H
+
+#include <stdint.h>
+
+// Public interface of librocketsim, for programs which advance the simulation themselves.
+// The simulation runs on the caller's thread in virtual time: no threads are started and nothing sleeps.
+
+// System statuses returned by `rocketsim_system_status`
+#define ROCKETSIM_TERMINATE 0
+#define ROCKETSIM_DISABLED  1
+#define ROCKETSIM_SLOW      2
+#define ROCKETSIM_STANDARD  3
+#define ROCKETSIM_FAST      4
+
+typedef struct RocketSim RocketSim;
+
+// Lifecycle
+RocketSim *rocketsim_init(uint64_t seed);
+void rocketsim_destroy(RocketSim *sim);
+
+// Loading
+void rocketsim_load_default(RocketSim *sim);
+int rocketsim_add_resource(RocketSim *sim, const char *name, int amount, int max_capacity);
+int rocketsim_add_system(RocketSim *sim, const char *name, int consumed_id, int consumed_amount,
+                         int produced_id, int produced_amount, int processing_time);
+
+// Stepping
+int rocketsim_step(RocketSim *sim, double dt);
+
+// Queries
+double rocketsim_time(const RocketSim *sim);
+int rocketsim_running(const RocketSim *sim);
+int rocketsim_resource_count(const RocketSim *sim);
+int rocketsim_find_resource(const RocketSim *sim, const char *name);
+int rocketsim_resource_amount(const RocketSim *sim, int resource_id);
+int rocketsim_system_count(const RocketSim *sim);
+int rocketsim_system_status(const RocketSim *sim, int system_id);
+
+#endif
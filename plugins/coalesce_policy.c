@@ -0,0 +1,70 @@
+#include "policy.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The built-in rules with one decision per resource per batch: only the latest event about a resource decides its
+// producers' speed, so a resource reported low and full many times within a tick costs one speed change.
+// Ends each batch with the same speeds as the built-in policy, with fewer writes when events repeat.
+
+// Batch number in which each resource was last decided, so finding the latest event needs no clearing
+typedef struct CoalesceContext {
+    int *decided;
+    int capacity;
+    int batch;
+} CoalesceContext;
+
+static void *coalesce_create(const PolicyState *state) {
+    CoalesceContext *context = (CoalesceContext *)malloc(sizeof(CoalesceContext));
+    context->capacity = state->resource_count > 0 ? state->resource_count : 1;
+    context->decided = (int *)calloc(context->capacity, sizeof(int));
+    context->batch = 0;
+    return context;
+}
+
+static void coalesce_destroy(void *context) {
+    free(((CoalesceContext *)context)->decided);
+    free(context);
+}
+
+static int coalesce_decide(void *opaque, const PolicyState *state, const PolicyEvent *events, int event_count,
+                           PolicyDecision *decisions, int capacity) {
+    CoalesceContext *context = (CoalesceContext *)opaque;
+    int count = 0;
+
+    if (state->resource_count > context->capacity) {
+        free(context->decided);
+        context->capacity = state->resource_count;
+        context->decided = (int *)calloc(context->capacity, sizeof(int));
+    }
+    context->batch++;
+
+    for (int i = 0; i < event_count; i++) {
+        const char *name = state->resources[events[i].resource].name;
+        if ((events[i].status == POLICY_STATUS_EMPTY && strcmp(name, "Oxygen") == 0) ||
+            (events[i].status == POLICY_STATUS_CAPACITY && strcmp(name, "Distance") == 0)) {
+            decisions[0].kind = POLICY_STOP;
+            decisions[0].id = events[i].resource;
+            decisions[0].status = POLICY_TERMINATE;
+            return capacity > 0 ? 1 : 0;
+        }
+    }
+
+    for (int i = event_count - 1; i >= 0 && count < capacity; i--) {
+        int resource = events[i].resource;
+        if (context->decided[resource] == context->batch) {
+            continue;
+        }
+        context->decided[resource] = context->batch;
+        decisions[count].kind = POLICY_SET_PRODUCERS;
+        decisions[count].id = resource;
+        decisions[count].status = (events[i].status == POLICY_STATUS_CAPACITY) ? POLICY_SLOW : POLICY_FAST;
+        count++;
+    }
+    return count;
+}
+
+static const Policy coalesce_policy = {POLICY_API_VERSION, "coalesce", coalesce_create, coalesce_destroy, coalesce_decide};
+
+const Policy *rocketsim_policy(void) {
+    return &coalesce_policy;
+}
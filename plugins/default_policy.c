@@ -0,0 +1,35 @@
+#include "policy.h"
+#include <string.h>
+
+// The manager's built-in policy as a plugin: producers of a resource go FAST when it runs low, empty or short,
+// SLOW when it is at capacity, and the simulation stops when Oxygen runs out or the Distance is reached.
+// Replaying a trace with and without it gives the same decision digest.
+
+static int default_decide(void *context, const PolicyState *state, const PolicyEvent *events, int event_count,
+                          PolicyDecision *decisions, int capacity) {
+    int count = 0;
+    (void)context;
+
+    for (int i = 0; i < event_count && count < capacity; i++) {
+        const PolicyEvent *event = &events[i];
+        const char *name = state->resources[event->resource].name;
+        PolicyDecision *decision = &decisions[count++];
+
+        decision->id = event->resource;
+        if ((event->status == POLICY_STATUS_EMPTY && strcmp(name, "Oxygen") == 0) ||
+            (event->status == POLICY_STATUS_CAPACITY && strcmp(name, "Distance") == 0)) {
+            decision->kind = POLICY_STOP;
+            decision->status = POLICY_TERMINATE;
+        } else {
+            decision->kind = POLICY_SET_PRODUCERS;
+            decision->status = (event->status == POLICY_STATUS_CAPACITY) ? POLICY_SLOW : POLICY_FAST;
+        }
+    }
+    return count;
+}
+
+static const Policy default_policy = {POLICY_API_VERSION, "default", NULL, NULL, default_decide};
+
+const Policy *rocketsim_policy(void) {
+    return &default_policy;
+}
@@ -0,0 +1,157 @@
+#define ALLOC_IMPLEMENTATION   // The wrappers call the real allocator
+#include "defs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// One allocating call site
+typedef struct AllocSite {
+    const char *file;     // NULL for an unused slot
+    int line;
+    long calls;
+    long bytes;
+    long after_warmup;    // Calls made once the warm-up had passed
+} AllocSite;
+
+// The table is static and guarded by a spinlock, so tracking itself never allocates and needs no initialization
+static AllocSite alloc_sites[ALLOC_MAX_SITES + 1];   // The extra slot collects sites which did not fit
+static int alloc_site_lock = 0;
+static int alloc_warmup_set = 0;
+static double alloc_warmup_end = 0.0;    // Monotonic milliseconds after which allocations are reported
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static void alloc_record(size_t size, const char *file, int line);
+static double alloc_now_ms(void);
+static int alloc_compare_sites(const void *a, const void *b);
+
+void *alloc_track_malloc(size_t size, const char *file, int line) {
+    alloc_record(size, file, line);
+    return malloc(size);
+}
+
+void *alloc_track_calloc(size_t count, size_t size, const char *file, int line) {
+    alloc_record(count * size, file, line);
+    return calloc(count, size);
+}
+
+void *alloc_track_aligned_alloc(size_t alignment, size_t size, const char *file, int line) {
+    alloc_record(size, file, line);
+    return aligned_alloc(alignment, size);
+}
+
+char *alloc_track_strdup(const char *string, const char *file, int line) {
+    alloc_record(strlen(string) + 1, file, line);
+    return strdup(string);
+}
+
+/**
+ * Returns non-zero if the build routes allocations through the tracking wrappers.
+ */
+int alloc_tracking_enabled(void) {
+#ifdef ALLOC_TRACKING
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Starts the warm-up period: allocations made more than `warmup_ms` milliseconds from now are reported.
+ *
+ * @param[in] warmup_ms  Length of the warm-up in milliseconds.
+ */
+void alloc_tracking_start(double warmup_ms) {
+    alloc_warmup_end = alloc_now_ms() + warmup_ms;
+    __atomic_store_n(&alloc_warmup_set, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Prints every call site with its calls and bytes, largest first, and the sites which allocated after the warm-up.
+ *
+ * @param[in] stream  Stream to print to.
+ * @return            Number of allocations made after the warm-up.
+ */
+long alloc_tracking_report(FILE *stream) {
+    AllocSite sorted[ALLOC_MAX_SITES + 1];
+    int count = 0;
+    long calls = 0, bytes = 0, after_warmup = 0;
+
+    while (__atomic_test_and_set(&alloc_site_lock, __ATOMIC_ACQUIRE)) {
+        // Spin, only held for a table update
+    }
+    for (int i = 0; i <= ALLOC_MAX_SITES; i++) {
+        if (alloc_sites[i].file) {
+            sorted[count++] = alloc_sites[i];
+        }
+    }
+    __atomic_clear(&alloc_site_lock, __ATOMIC_RELEASE);
+
+    qsort(sorted, count, sizeof(AllocSite), alloc_compare_sites);
+    fprintf(stream, "%-32s %10s %12s %12s\n", "Allocation site", "Calls", "Bytes", "After warm-up");
+    for (int i = 0; i < count; i++) {
+        char site[64];
+        snprintf(site, sizeof(site), "%s:%d", sorted[i].file, sorted[i].line);
+        fprintf(stream, "%-32s %10ld %12ld %12ld\n", site, sorted[i].calls, sorted[i].bytes, sorted[i].after_warmup);
+        calls += sorted[i].calls;
+        bytes += sorted[i].bytes;
+        after_warmup += sorted[i].after_warmup;
+    }
+    fprintf(stream, "%-32s %10ld %12ld %12ld\n", "Total", calls, bytes, after_warmup);
+    return after_warmup;
+}
+
+/**
+ * Adds one allocation to its call site, reporting it if the warm-up has passed and the site had not allocated since.
+ *
+ * Sites are found by open addressing on the address of the file name and the line.
+ *
+ * @param[in] size  Bytes requested.
+ * @param[in] file  Source file of the call.
+ * @param[in] line  Source line of the call.
+ */
+static void alloc_record(size_t size, const char *file, int line) {
+    int after_warmup = __atomic_load_n(&alloc_warmup_set, __ATOMIC_ACQUIRE) && alloc_now_ms() >= alloc_warmup_end;
+    unsigned index = (unsigned)(((uintptr_t)file >> 3) * 31u + (unsigned)line) % ALLOC_MAX_SITES;
+    AllocSite *site = NULL;
+
+    while (__atomic_test_and_set(&alloc_site_lock, __ATOMIC_ACQUIRE)) {
+        // Spin, only held for a table update
+    }
+    for (int probe = 0; probe < ALLOC_MAX_SITES; probe++) {
+        AllocSite *slot = &alloc_sites[(index + probe) % ALLOC_MAX_SITES];
+        if (!slot->file) {
+            slot->file = file;
+            slot->line = line;
+        }
+        if (slot->file == file && slot->line == line) {
+            site = slot;
+            break;
+        }
+    }
+    if (!site) {
+        site = &alloc_sites[ALLOC_MAX_SITES];
+        site->file = "other";
+    }
+
+    site->calls++;
+    site->bytes += (long)size;
+    int first_after_warmup = after_warmup && site->after_warmup++ == 0;
+    __atomic_clear(&alloc_site_lock, __ATOMIC_RELEASE);
+
+    if (first_after_warmup) {
+        fprintf(stderr, "Allocation after warm-up: %s:%d (%zu bytes)\n", file, line, size);
+    }
+}
+
+static double alloc_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+static int alloc_compare_sites(const void *a, const void *b) {
+    long x = ((const AllocSite *)a)->bytes, y = ((const AllocSite *)b)->bytes;
+    return (x < y) - (x > y);
+}
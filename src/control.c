@@ -0,0 +1,394 @@
+#include "defs.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define CONTROL_POLL_MS 200   // How often the control thread checks whether it should stop
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static void *control_thread(void *arg);
+static void control_serve(Control *control, int fd);
+static void control_handle(Control *control, int fd, char *line);
+static int control_pause(Manager *manager, int *expected);
+static int control_expected_threads(Manager *manager);
+static void control_query(Manager *manager, int fd, const char *what);
+static void control_reply(int fd, const char *format, ...);
+static void control_sleep_ms(int ms);
+
+/* PauseGate functions */
+
+/**
+ * Initializes an open `PauseGate`.
+ *
+ * @param[out] gate  Pointer to the `PauseGate` to initialize.
+ */
+void pause_gate_init(PauseGate *gate) {
+    gate->closed = 0;
+    gate->step_ticks = 0;
+    gate->held = 0;
+    pthread_mutex_init(&gate->mutex, NULL);
+    pthread_cond_init(&gate->changed, NULL);
+}
+
+/**
+ * Cleans up a `PauseGate`. No thread may be waiting at it.
+ *
+ * @param[in,out] gate  Pointer to the `PauseGate` to clean.
+ */
+void pause_gate_clean(PauseGate *gate) {
+    pthread_mutex_destroy(&gate->mutex);
+    pthread_cond_destroy(&gate->changed);
+}
+
+/**
+ * Waits while the gate is closed. Called by each thread at a point where it holds no lock, no input and no
+ * reservation, so a paused simulation is consistent.
+ *
+ * @param[in,out] gate  Pointer to the `PauseGate`.
+ * @return              1 if the thread was held, 0 if the gate was open.
+ */
+int pause_gate_pass(PauseGate *gate) {
+    if (!__atomic_load_n(&gate->closed, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&gate->mutex);
+    gate->held++;
+    pthread_cond_broadcast(&gate->changed);
+    while (gate->closed) {
+        pthread_cond_wait(&gate->changed, &gate->mutex);
+    }
+    gate->held--;
+    pthread_mutex_unlock(&gate->mutex);
+    return 1;
+}
+
+/**
+ * Counts one manager tick towards a step, closing the gate once the step is done.
+ * Called by whatever drives `manager_run`, after each tick.
+ *
+ * @param[in,out] gate  Pointer to the `PauseGate`.
+ */
+void pause_gate_tick(PauseGate *gate) {
+    if (__atomic_load_n(&gate->step_ticks, __ATOMIC_ACQUIRE) == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&gate->mutex);
+    if (gate->step_ticks > 0 && --gate->step_ticks == 0) {
+        __atomic_store_n(&gate->closed, 1, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&gate->changed);
+    }
+    pthread_mutex_unlock(&gate->mutex);
+}
+
+/**
+ * Closes the gate: every thread stops at its next pass.
+ *
+ * @param[in,out] gate  Pointer to the `PauseGate`.
+ */
+void pause_gate_close(PauseGate *gate) {
+    pthread_mutex_lock(&gate->mutex);
+    gate->step_ticks = 0;
+    __atomic_store_n(&gate->closed, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&gate->changed);
+    pthread_mutex_unlock(&gate->mutex);
+}
+
+/**
+ * Opens the gate, for good or for a number of manager ticks.
+ *
+ * @param[in,out] gate        Pointer to the `PauseGate`.
+ * @param[in]     step_ticks  Manager ticks after which the gate closes again, zero to stay open.
+ */
+void pause_gate_open(PauseGate *gate, long step_ticks) {
+    pthread_mutex_lock(&gate->mutex);
+    gate->step_ticks = step_ticks;
+    __atomic_store_n(&gate->closed, 0, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&gate->changed);
+    pthread_mutex_unlock(&gate->mutex);
+}
+
+/* Control functions */
+
+/**
+ * Creates the control socket and starts the thread serving it.
+ *
+ * Commands, one per line, each answered with lines ending in "ok" or "error: ...":
+ *   pause              Hold every thread at its next safe point and wait for them to arrive.
+ *   resume             Let the simulation run again.
+ *   step N             Run N manager ticks from a pause, then pause again.
+ *   query [resources|systems]  Print amounts, speeds and stored amounts.
+ *   checkpoint PATH    Write the current state as a one-snapshot journal, read back with `--seek PATH 0`.
+ *
+ * @param[out] control  Pointer to the `Control` to start.
+ * @param[in]  path     Path of the socket, replaced if it exists.
+ * @param[in]  manager  Pointer to the `Manager` to control.
+ * @return              0 on success, -1 if the socket could not be created.
+ */
+int control_start(Control *control, const char *path, Manager *manager) {
+    struct sockaddr_un address;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    control->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (control->listen_fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (bind(control->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(control->listen_fd, 1) != 0) {
+        close(control->listen_fd);
+        return -1;
+    }
+
+    control->manager = manager;
+    strcpy(control->path, path);
+    control->stopping = 0;
+    pthread_create(&control->thread, NULL, control_thread, control);
+    return 0;
+}
+
+/**
+ * Stops the control thread and removes the socket. A simulation left paused is not resumed.
+ *
+ * @param[in,out] control  Pointer to the started `Control`.
+ */
+void control_stop(Control *control) {
+    __atomic_store_n(&control->stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(control->thread, NULL);
+    close(control->listen_fd);
+    unlink(control->path);
+}
+
+/**
+ * Accepts clients one at a time until stopped. Waits with a timeout so a stop request is seen promptly.
+ *
+ * @param[in,out] arg  Pointer to the `Control`.
+ * @return             NULL.
+ */
+static void *control_thread(void *arg) {
+    Control *control = (Control *)arg;
+    struct pollfd listener = {control->listen_fd, POLLIN, 0};
+
+    while (!__atomic_load_n(&control->stopping, __ATOMIC_ACQUIRE)) {
+        if (poll(&listener, 1, CONTROL_POLL_MS) <= 0) {
+            continue;
+        }
+        int fd = accept(control->listen_fd, NULL, NULL);
+        if (fd >= 0) {
+            control_serve(control, fd);
+            close(fd);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Reads commands from one client, line by line, until it disconnects or the control thread is stopped.
+ *
+ * @param[in,out] control  Pointer to the `Control`.
+ * @param[in]     fd       Connected client socket.
+ */
+static void control_serve(Control *control, int fd) {
+    char buffer[CONTROL_LINE_SIZE];
+    int length = 0;
+    struct pollfd client = {fd, POLLIN, 0};
+
+    while (!__atomic_load_n(&control->stopping, __ATOMIC_ACQUIRE)) {
+        if (poll(&client, 1, CONTROL_POLL_MS) <= 0) {
+            continue;
+        }
+        ssize_t received = read(fd, buffer + length, sizeof(buffer) - 1 - length);
+        if (received <= 0) {
+            return;
+        }
+        length += (int)received;
+        buffer[length] = '\0';
+
+        char *line = buffer, *end;
+        while ((end = strchr(line, '\n')) != NULL) {
+            *end = '\0';
+            if (end > line && end[-1] == '\r') {
+                end[-1] = '\0';
+            }
+            control_handle(control, fd, line);
+            line = end + 1;
+        }
+        length = (int)strlen(line);
+        memmove(buffer, line, length + 1);
+        if (length == (int)sizeof(buffer) - 1) {
+            control_reply(fd, "error: line too long\n");
+            length = 0;
+        }
+    }
+}
+
+/**
+ * Runs one command and writes its answer.
+ *
+ * @param[in,out] control  Pointer to the `Control`.
+ * @param[in]     fd       Client socket.
+ * @param[in,out] line     Command line without its newline.
+ */
+static void control_handle(Control *control, int fd, char *line) {
+    Manager *manager = control->manager;
+    PauseGate *gate = &manager->gate;
+    char *command = strtok(line, " \t");
+    char *argument = strtok(NULL, " \t");
+    int expected;
+
+    if (!command) {
+        return;
+    }
+
+    if (strcmp(command, "pause") == 0) {
+        int held = control_pause(manager, &expected);
+        control_reply(fd, "paused: %d of %d threads held at %.1f ms\nok\n", held, expected, manager->clock);
+    } else if (strcmp(command, "resume") == 0) {
+        pause_gate_open(gate, 0);
+        control_reply(fd, "ok\n");
+    } else if (strcmp(command, "step") == 0) {
+        long ticks = argument ? atol(argument) : 1;
+        if (ticks <= 0) {
+            control_reply(fd, "error: step needs a positive number of ticks\n");
+            return;
+        }
+        control_pause(manager, &expected);
+        double before = manager->clock;
+        pause_gate_open(gate, ticks);
+        int waited = 0;
+        while (manager->simulation_running && __atomic_load_n(&gate->step_ticks, __ATOMIC_ACQUIRE) > 0 &&
+               waited < ticks * MANAGER_WAIT_TIME * 20 + CONTROL_PAUSE_TIMEOUT) {
+            control_sleep_ms(1);
+            waited++;
+        }
+        int held = control_pause(manager, &expected);
+        control_reply(fd, "stepped %ld ticks from %.1f ms to %.1f ms: %d of %d threads held\nok\n", ticks, before,
+                      manager->clock, held, expected);
+    } else if (strcmp(command, "query") == 0) {
+        control_query(manager, fd, argument);
+    } else if (strcmp(command, "checkpoint") == 0 && argument) {
+        Journal journal;
+        int was_paused = __atomic_load_n(&gate->closed, __ATOMIC_ACQUIRE);
+        int held = control_pause(manager, &expected);
+        if (held < expected) {
+            // A thread still running could change the state while it is written, the checkpoint would be torn
+            if (!was_paused) {
+                pause_gate_open(gate, 0);
+            }
+            control_reply(fd, "error: only %d of %d threads held, no checkpoint written\n", held, expected);
+            return;
+        }
+        int result = journal_open(&journal, argument, manager);
+        if (result == 0) {
+            result = journal_close(&journal);
+        }
+        if (!was_paused) {
+            pause_gate_open(gate, 0);
+        }
+        if (result == 0) {
+            control_reply(fd, "checkpoint at %.1f ms written to %s, read it with --seek %s 0\nok\n", manager->clock,
+                          argument, argument);
+        } else {
+            control_reply(fd, "error: cannot write %s\n", argument);
+        }
+    } else if (strcmp(command, "help") == 0) {
+        control_reply(fd, "pause | resume | step N | query [resources|systems] | checkpoint PATH\nok\n");
+    } else {
+        control_reply(fd, "error: unknown command %s\n", command);
+    }
+}
+
+/**
+ * Closes the gate and waits, up to `CONTROL_PAUSE_TIMEOUT`, for every running thread to reach it.
+ *
+ * @param[in,out] manager   Pointer to the `Manager`.
+ * @param[out]    expected  Number of threads expected at the gate.
+ * @return                  Number of threads held.
+ */
+static int control_pause(Manager *manager, int *expected) {
+    PauseGate *gate = &manager->gate;
+    int held;
+
+    pause_gate_close(gate);
+    for (int waited = 0;; waited++) {
+        *expected = control_expected_threads(manager);
+        held = __atomic_load_n(&gate->held, __ATOMIC_ACQUIRE);
+        if (held >= *expected || waited >= CONTROL_PAUSE_TIMEOUT || !manager->simulation_running) {
+            return held;
+        }
+        control_sleep_ms(1);
+    }
+}
+
+/**
+ * Counts the threads which should reach the gate: the thread driving the manager, and every system thread which
+ * has not terminated and is not parked on a waiter list (a parked thread is held anyway, and passes when woken).
+ */
+static int control_expected_threads(Manager *manager) {
+    int expected = 1;
+
+    if (!manager->threads_running) {
+        return expected;
+    }
+    for (int i = 0; i < manager->system_array.size && i < manager->system_thread_capacity; i++) {
+        System *system = manager->system_array.systems[i];
+        if (manager->system_thread_started[i] && system->status != TERMINATE &&
+            __atomic_load_n(&system->waiting_on, __ATOMIC_ACQUIRE) == NULL) {
+            expected++;
+        }
+    }
+    return expected;
+}
+
+/**
+ * Writes the amount of every resource and the speed and stored amount of every system.
+ *
+ * @param[in] manager  Pointer to the `Manager`.
+ * @param[in] fd       Client socket.
+ * @param[in] what     "resources", "systems", or NULL for both.
+ */
+static void control_query(Manager *manager, int fd, const char *what) {
+    int resources = !what || strcmp(what, "resources") == 0;
+    int systems = !what || strcmp(what, "systems") == 0;
+
+    if (!resources && !systems) {
+        control_reply(fd, "error: query resources or systems\n");
+        return;
+    }
+    control_reply(fd, "clock %.1f ms, %s\n", manager->clock,
+                  !manager->simulation_running ? "terminated" : manager->gate.closed ? "paused" : "running");
+    for (int i = 0; resources && i < manager->resource_array.size; i++) {
+        Resource *resource = manager->resource_array.resources[i];
+        control_reply(fd, "resource %d %s %d/%d\n", i, resource->name, __atomic_load_n(&resource->amount, __ATOMIC_RELAXED),
+                      resource->max_capacity);
+    }
+    for (int i = 0; systems && i < manager->system_array.size; i++) {
+        System *system = manager->system_array.systems[i];
+        control_reply(fd, "system %d %s speed %d stored %d\n", i, system->name, system_speed(system),
+                      __atomic_load_n(&system->amount_stored, __ATOMIC_RELAXED));
+    }
+    control_reply(fd, "ok\n");
+}
+
+static void control_reply(int fd, const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    vdprintf(fd, format, arguments);
+    va_end(arguments);
+}
+
+static void control_sleep_ms(int ms) {
+    usleep(ms * 1000);
+}
@@ -0,0 +1,444 @@
+#include "defs.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define DASHBOARD_REQUEST_TIMEOUT_MS 100   // Time a new connection gets to send its request
+#define DASHBOARD_SEND_TIMEOUT_MS 1000     // A client whose socket stays full this long is dropped
+
+// Page served at /, rebuilding its tables from the "full" event and patching them with each "delta"
+static const char DASHBOARD_PAGE[] =
+    "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Rocket simulation</title><style>\n"
+    "body{font-family:sans-serif;margin:1em}table{border-collapse:collapse;display:inline-table;margin:0 2em 1em 0;"
+    "vertical-align:top}td,th{padding:1px 8px;text-align:left}meter{width:12em}\n"
+    ".FAST{color:#070}.SLOW{color:#a60}.DISABLED{color:#888}.TERMINATE{color:#c00}\n"
+    "</style></head><body><h3>Rocket simulation <span id=\"clock\"></span></h3>\n"
+    "<table id=\"resources\"><tr><th>Resource</th><th></th><th>Amount</th></tr></table>\n"
+    "<table id=\"systems\"><tr><th>System</th><th>Speed</th><th>Stored</th></tr></table>\n"
+    "<script>\n"
+    "const speeds=['TERMINATE','DISABLED','SLOW','STANDARD','FAST'];let r=[],s=[];\n"
+    "function row(t,cells){const tr=t.insertRow();return cells.map(c=>{const td=tr.insertCell();td.append(c);return td;});}\n"
+    "function amount(i,a){r[i].m.value=a;r[i].a.textContent=a+' / '+r[i].max;}\n"
+    "function speed(i,v,st){s[i].v.textContent=speeds[v];s[i].v.className=speeds[v];s[i].st.textContent=st;}\n"
+    "function clock(t,end){document.getElementById('clock').textContent=(t/1000).toFixed(1)+' s'+(end?', ended':'');}\n"
+    "const es=new EventSource('/events');\n"
+    "es.addEventListener('full',e=>{const d=JSON.parse(e.data);const rt=document.getElementById('resources'),"
+    "st=document.getElementById('systems');while(rt.rows.length>1)rt.deleteRow(1);while(st.rows.length>1)st.deleteRow(1);\n"
+    " r=d.resources.map(([n,a,max])=>{const m=document.createElement('meter');m.max=max;const c=row(rt,[n,m,'']);"
+    "return {m:m,a:c[2],max:max};});\n"
+    " s=d.systems.map(([n])=>{const c=row(st,[n,'','']);return {v:c[1],st:c[2]};});\n"
+    " d.resources.forEach(([n,a],i)=>amount(i,a));d.systems.forEach(([n,v,x],i)=>speed(i,v,x));clock(d.t);});\n"
+    "es.addEventListener('delta',e=>{const d=JSON.parse(e.data);d.r.forEach(([i,a])=>amount(i,a));"
+    "d.s.forEach(([i,v,x])=>speed(i,v,x));clock(d.t);});\n"
+    "es.addEventListener('end',e=>{clock(JSON.parse(e.data).t,true);es.close();});\n"
+    "</script></body></html>\n";
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static void *dashboard_thread(void *arg);
+static void dashboard_accept(Dashboard *dashboard);
+static void dashboard_frame(Dashboard *dashboard);
+static void dashboard_end(Dashboard *dashboard);
+static void dashboard_broadcast(Dashboard *dashboard);
+static void dashboard_drop(Dashboard *dashboard, int slot);
+static void dashboard_append(Dashboard *dashboard, const char *format, ...);
+static void dashboard_append_state(Dashboard *dashboard);
+static void dashboard_copy_name(char *name, size_t size, const char *source);
+static int dashboard_send(int fd, const char *data, size_t length);
+static double dashboard_now_ms(void);
+
+/**
+ * Listens on 127.0.0.1:`port` and starts the thread serving the dashboard.
+ *
+ * Routes:
+ *   /        The dashboard page.
+ *   /events  Server-sent events: one "full" event with every name, amount and speed, then a "delta" event per
+ *            frame with the values which changed, as [id, amount] and [id, speed, stored] pairs, and an "end" event.
+ *   /state   The "full" snapshot as a single JSON document.
+ *
+ * Only the resources and systems present when it starts are shown.
+ *
+ * @param[out] dashboard  Pointer to the `Dashboard` to start.
+ * @param[in]  port       TCP port, 0 for any free port (stored in `dashboard->port`).
+ * @param[in]  manager    Pointer to the `Manager` whose simulation is shown.
+ * @return                0 on success, -1 if the port could not be bound.
+ */
+int dashboard_start(Dashboard *dashboard, int port, Manager *manager) {
+    struct sockaddr_in address;
+    socklen_t address_length = sizeof(address);
+    int reuse = 1;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)port);
+
+    dashboard->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (dashboard->listen_fd < 0) {
+        return -1;
+    }
+    setsockopt(dashboard->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(dashboard->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(dashboard->listen_fd, DASHBOARD_MAX_CLIENTS) != 0) {
+        close(dashboard->listen_fd);
+        return -1;
+    }
+    getsockname(dashboard->listen_fd, (struct sockaddr *)&address, &address_length);
+    dashboard->port = ntohs(address.sin_port);
+
+    dashboard->manager = manager;
+    for (int i = 0; i < DASHBOARD_MAX_CLIENTS; i++) {
+        dashboard->clients[i] = -1;
+    }
+    dashboard->resource_count = manager->resource_array.size;
+    dashboard->system_count = manager->system_array.size;
+    dashboard->amounts = (int *)malloc(sizeof(int) * (dashboard->resource_count + 1));
+    dashboard->speeds = (int *)malloc(sizeof(int) * (dashboard->system_count + 1));
+    dashboard->stored = (int *)malloc(sizeof(int) * (dashboard->system_count + 1));
+    dashboard->capacity = DASHBOARD_INITIAL_BUFFER;
+    dashboard->buffer = (char *)malloc(dashboard->capacity);
+    dashboard->length = 0;
+    dashboard->frames = 0;
+    dashboard->bytes = 0;
+    dashboard->dropped = 0;
+    dashboard->stopping = 0;
+
+    // The first frame sends everything which differs from the loaded state
+    for (int i = 0; i < dashboard->resource_count; i++) {
+        dashboard->amounts[i] = manager->resource_array.resources[i]->amount;
+    }
+    for (int i = 0; i < dashboard->system_count; i++) {
+        dashboard->speeds[i] = system_speed(manager->system_array.systems[i]);
+        dashboard->stored[i] = manager->system_array.systems[i]->amount_stored;
+    }
+
+    pthread_create(&dashboard->thread, NULL, dashboard_thread, dashboard);
+    return 0;
+}
+
+/**
+ * Sends the last frame and the "end" event, then stops the dashboard thread and closes every connection.
+ *
+ * @param[in,out] dashboard  Pointer to the started `Dashboard`.
+ */
+void dashboard_stop(Dashboard *dashboard) {
+    __atomic_store_n(&dashboard->stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(dashboard->thread, NULL);
+    for (int i = 0; i < DASHBOARD_MAX_CLIENTS; i++) {
+        if (dashboard->clients[i] >= 0) {
+            close(dashboard->clients[i]);
+        }
+    }
+    close(dashboard->listen_fd);
+    free(dashboard->amounts);
+    free(dashboard->speeds);
+    free(dashboard->stored);
+    free(dashboard->buffer);
+}
+
+/**
+ * Serves connections and sends a frame every `DASHBOARD_FRAME_MS` until stopped.
+ * Waits on the listening socket and the streams between frames, so a closed browser tab is noticed at once.
+ *
+ * @param[in,out] arg  Pointer to the `Dashboard`.
+ * @return             NULL.
+ */
+static void *dashboard_thread(void *arg) {
+    Dashboard *dashboard = (Dashboard *)arg;
+    struct pollfd fds[DASHBOARD_MAX_CLIENTS + 1];
+    double next_frame = dashboard_now_ms();
+    int ended = 0;
+
+    while (!__atomic_load_n(&dashboard->stopping, __ATOMIC_ACQUIRE)) {
+        double now = dashboard_now_ms();
+        if (now >= next_frame) {
+            if (!ended) {
+                dashboard_frame(dashboard);
+            }
+            if (!ended && !dashboard->manager->simulation_running) {
+                dashboard_end(dashboard);
+                ended = 1;
+            }
+            next_frame += DASHBOARD_FRAME_MS;
+            if (next_frame < now) {
+                next_frame = now + DASHBOARD_FRAME_MS;
+            }
+            continue;
+        }
+
+        fds[0].fd = dashboard->listen_fd;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < DASHBOARD_MAX_CLIENTS; i++) {
+            fds[i + 1].fd = dashboard->clients[i];   // Negative descriptors are ignored by poll
+            fds[i + 1].events = POLLIN;
+            fds[i + 1].revents = 0;
+        }
+        if (poll(fds, DASHBOARD_MAX_CLIENTS + 1, (int)(next_frame - now) + 1) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < DASHBOARD_MAX_CLIENTS; i++) {
+            char discard[256];
+            if (fds[i + 1].revents && dashboard->clients[i] >= 0 && read(dashboard->clients[i], discard, sizeof(discard)) <= 0) {
+                close(dashboard->clients[i]);
+                dashboard->clients[i] = -1;
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            dashboard_accept(dashboard);
+        }
+    }
+
+    if (!ended) {
+        dashboard_frame(dashboard);
+        dashboard_end(dashboard);
+    }
+    return NULL;
+}
+
+/**
+ * Accepts one connection, reads its request and answers it. Event streams are kept, other connections closed.
+ *
+ * @param[in,out] dashboard  Pointer to the `Dashboard`.
+ */
+static void dashboard_accept(Dashboard *dashboard) {
+    char request[DASHBOARD_REQUEST_SIZE];
+    size_t length = 0;
+    struct timeval timeout = {DASHBOARD_SEND_TIMEOUT_MS / 1000, (DASHBOARD_SEND_TIMEOUT_MS % 1000) * 1000};
+    int fd = accept(dashboard->listen_fd, NULL, NULL);
+
+    if (fd < 0) {
+        return;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // A client which does not send its request in time is not waited for
+    struct pollfd client = {fd, POLLIN, 0};
+    request[0] = '\0';
+    while (!strstr(request, "\r\n\r\n") && length < sizeof(request) - 1 && poll(&client, 1, DASHBOARD_REQUEST_TIMEOUT_MS) > 0) {
+        ssize_t received = read(fd, request + length, sizeof(request) - 1 - length);
+        if (received <= 0) {
+            break;
+        }
+        length += (size_t)received;
+        request[length] = '\0';
+    }
+
+    char path[64] = "";
+    if (sscanf(request, "GET %63s HTTP/", path) != 1) {
+        static const char bad[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        dashboard_send(fd, bad, sizeof(bad) - 1);
+        close(fd);
+        return;
+    }
+
+    dashboard->length = 0;
+    if (strcmp(path, "/") == 0 || strcmp(path, "/index.html") == 0) {
+        dashboard_append(dashboard, "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\n"
+                         "Content-Length: %zu\r\nConnection: close\r\n\r\n%s", sizeof(DASHBOARD_PAGE) - 1, DASHBOARD_PAGE);
+    } else if (strcmp(path, "/state") == 0) {
+        dashboard_append(dashboard, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n");
+        dashboard_append_state(dashboard);
+        dashboard_append(dashboard, "\n");
+    } else if (strcmp(path, "/events") == 0) {
+        int slot = 0;
+        while (slot < DASHBOARD_MAX_CLIENTS && dashboard->clients[slot] >= 0) {
+            slot++;
+        }
+        if (slot == DASHBOARD_MAX_CLIENTS) {
+            dashboard_append(dashboard, "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        } else {
+            dashboard_append(dashboard, "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+                             "Connection: keep-alive\r\n\r\nevent: full\ndata: ");
+            dashboard_append_state(dashboard);
+            dashboard_append(dashboard, "\n\n");
+            if (dashboard_send(fd, dashboard->buffer, dashboard->length) == 0) {
+                dashboard->clients[slot] = fd;
+            } else {
+                close(fd);
+            }
+            return;
+        }
+    } else {
+        dashboard_append(dashboard, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    }
+    dashboard_send(fd, dashboard->buffer, dashboard->length);
+    close(fd);
+}
+
+/**
+ * Samples every amount, speed and stored amount without locking, like the terminal display reads them,
+ * and sends the ones which changed since the last frame to every stream. Nothing is sent when nothing changed.
+ *
+ * @param[in,out] dashboard  Pointer to the `Dashboard`.
+ */
+static void dashboard_frame(Dashboard *dashboard) {
+    Manager *manager = dashboard->manager;
+    int changes = 0;
+
+    dashboard->length = 0;
+    dashboard_append(dashboard, "event: delta\ndata: {\"t\":%.1f,\"r\":[", manager->clock);
+    for (int i = 0; i < dashboard->resource_count; i++) {
+        int amount = __atomic_load_n(&manager->resource_array.resources[i]->amount, __ATOMIC_RELAXED);
+        if (amount != dashboard->amounts[i]) {
+            dashboard_append(dashboard, "%s[%d,%d]", changes++ ? "," : "", i, amount);
+            dashboard->amounts[i] = amount;
+        }
+    }
+    dashboard_append(dashboard, "],\"s\":[");
+    int resource_changes = changes;
+    for (int i = 0; i < dashboard->system_count; i++) {
+        System *system = manager->system_array.systems[i];
+        int speed = system_speed(system);
+        int stored = __atomic_load_n(&system->amount_stored, __ATOMIC_RELAXED);
+        if (speed != dashboard->speeds[i] || stored != dashboard->stored[i]) {
+            dashboard_append(dashboard, "%s[%d,%d,%d]", changes++ > resource_changes ? "," : "", i, speed, stored);
+            dashboard->speeds[i] = speed;
+            dashboard->stored[i] = stored;
+        }
+    }
+    dashboard_append(dashboard, "]}\n\n");
+
+    if (changes > 0) {
+        dashboard->frames++;
+        dashboard_broadcast(dashboard);
+    }
+}
+
+/**
+ * Tells every stream that the simulation ended, with the final clock.
+ *
+ * @param[in,out] dashboard  Pointer to the `Dashboard`.
+ */
+static void dashboard_end(Dashboard *dashboard) {
+    dashboard->length = 0;
+    dashboard_append(dashboard, "event: end\ndata: {\"t\":%.1f}\n\n", dashboard->manager->clock);
+    dashboard_broadcast(dashboard);
+}
+
+/**
+ * Sends the message in the buffer to every stream, dropping the streams which cannot take it.
+ *
+ * @param[in,out] dashboard  Pointer to the `Dashboard`.
+ */
+static void dashboard_broadcast(Dashboard *dashboard) {
+    for (int i = 0; i < DASHBOARD_MAX_CLIENTS; i++) {
+        if (dashboard->clients[i] < 0) {
+            continue;
+        }
+        if (dashboard_send(dashboard->clients[i], dashboard->buffer, dashboard->length) == 0) {
+            dashboard->bytes += (long)dashboard->length;
+        } else {
+            dashboard_drop(dashboard, i);
+        }
+    }
+}
+
+static void dashboard_drop(Dashboard *dashboard, int slot) {
+    close(dashboard->clients[slot]);
+    dashboard->clients[slot] = -1;
+    dashboard->dropped++;
+}
+
+/**
+ * Appends formatted text to the message buffer, growing it if necessary (doubling the size).
+ *
+ * Use of realloc is NOT permitted.
+ *
+ * @param[in,out] dashboard  Pointer to the `Dashboard`.
+ * @param[in]     format     printf format.
+ */
+static void dashboard_append(Dashboard *dashboard, const char *format, ...) {
+    va_list arguments;
+
+    for (;;) {
+        va_start(arguments, format);
+        int written = vsnprintf(dashboard->buffer + dashboard->length, dashboard->capacity - dashboard->length, format, arguments);
+        va_end(arguments);
+        if (written < 0) {
+            return;
+        }
+        if ((size_t)written < dashboard->capacity - dashboard->length) {
+            dashboard->length += (size_t)written;
+            return;
+        }
+
+        size_t capacity = dashboard->capacity * 2;
+        while (capacity <= dashboard->length + (size_t)written) {
+            capacity *= 2;
+        }
+        char *buffer = (char *)malloc(capacity);
+        memcpy(buffer, dashboard->buffer, dashboard->length);
+        free(dashboard->buffer);
+        dashboard->buffer = buffer;
+        dashboard->capacity = capacity;
+    }
+}
+
+/**
+ * Appends the snapshot the streams were last sent as JSON: names, amounts and capacities of the resources,
+ * names, speeds and stored amounts of the systems.
+ *
+ * @param[in,out] dashboard  Pointer to the `Dashboard`.
+ */
+static void dashboard_append_state(Dashboard *dashboard) {
+    Manager *manager = dashboard->manager;
+    char name[128];
+
+    dashboard_append(dashboard, "{\"t\":%.1f,\"resources\":[", manager->clock);
+    for (int i = 0; i < dashboard->resource_count; i++) {
+        Resource *resource = manager->resource_array.resources[i];
+        dashboard_copy_name(name, sizeof(name), resource->name);
+        dashboard_append(dashboard, "%s[\"%s\",%d,%d]", i ? "," : "", name, dashboard->amounts[i], resource->max_capacity);
+    }
+    dashboard_append(dashboard, "],\"systems\":[");
+    for (int i = 0; i < dashboard->system_count; i++) {
+        System *system = manager->system_array.systems[i];
+        dashboard_copy_name(name, sizeof(name), system->name);
+        dashboard_append(dashboard, "%s[\"%s\",%d,%d]", i ? "," : "", name, dashboard->speeds[i], dashboard->stored[i]);
+    }
+    dashboard_append(dashboard, "]}");
+}
+
+/**
+ * Copies a scenario name for a JSON string, dropping the quotes, backslashes and control characters
+ * which would need escaping.
+ */
+static void dashboard_copy_name(char *name, size_t size, const char *source) {
+    size_t length = 0;
+
+    for (const char *c = source; *c && length < size - 1; c++) {
+        if (*c != '"' && *c != '\\' && (unsigned char)*c >= ' ') {
+            name[length++] = *c;
+        }
+    }
+    name[length] = '\0';
+}
+
+/**
+ * Writes all of `data`, waiting at most `DASHBOARD_SEND_TIMEOUT_MS` for room in the socket each time.
+ *
+ * @return  0 if everything was written, -1 if the client is gone or too slow.
+ */
+static int dashboard_send(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return -1;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+static double dashboard_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+static int event_priority_level(int priority);
+
 /* Event functions */
 
 /**
@@ -30,14 +32,18 @@ void event_init(Event *event, System *system, Resource *resource, int status, in
 /**
  * Initializes the `EventQueue`.
  *
- * Sets up the queue for use, initializing any necessary data (e.g., semaphores when threading).
+ * Sets up the queue for use, initializing any necessary data (e.g., the lock when threading).
  *
  * @param[out] queue  Pointer to the `EventQueue` to initialize.
  */
 void event_queue_init(EventQueue *queue) {
     queue->head = NULL;
+    for (int i = 0; i < PRIORITY_LEVELS; i++) {
+        queue->tails[i] = NULL;
+    }
+    queue->free_nodes = NULL;
     queue->size = 0;
-    sem_init(&queue->lock, 0, 1); 
+    lock_init(&queue->lock); 
 }
 
 /**
@@ -55,66 +61,136 @@ void event_queue_clean(EventQueue *queue) {
         free(current);
         current = next;
     }
-    sem_destroy(&queue->lock);  
+    current = queue->free_nodes;
+    while (current) {
+        next = current->next;
+        free(current);
+        current = next;
+    }
+    queue->free_nodes = NULL;
+    lock_destroy(&queue->lock);  
     queue->head = NULL;
+    for (int i = 0; i < PRIORITY_LEVELS; i++) {
+        queue->tails[i] = NULL;
+    }
     queue->size = 0;
 }
 
+/**
+ * Makes sure the `EventQueue` holds at least `count` nodes, queued or free, allocating the missing ones now.
+ *
+ * Called before the threads start, so pushes of the running simulation do not allocate while the queue
+ * stays within `count` events.
+ *
+ * @param[in,out] queue  Pointer to the `EventQueue`.
+ * @param[in]     count  Number of nodes to hold.
+ */
+void event_queue_reserve(EventQueue *queue, int count) {
+    lock_acquire(&queue->lock);
+
+    int nodes = queue->size;
+    for (EventNode *node = queue->free_nodes; node; node = node->next) {
+        nodes++;
+    }
+    for (; nodes < count; nodes++) {
+        EventNode *node = (EventNode *)malloc(sizeof(EventNode));
+        node->next = queue->free_nodes;
+        queue->free_nodes = node;
+    }
+
+    lock_release(&queue->lock);
+}
+
 /**
  * Pushes an `Event` onto the `EventQueue`.
  *
  * Adds the event to the queue in a thread-safe manner, maintaining priority order (highest first).
+ * The tail of each priority band is tracked, so pushing takes constant time however long the queue is.
+ * Nodes released by `event_queue_pop` are reused, so once the queue has reached its usual depth pushing does not allocate.
  *
  * @param[in,out] queue  Pointer to the `EventQueue`.
  * @param[in]     event  Pointer to the `Event` to push onto the queue.
  */
 void event_queue_push(EventQueue *queue, const Event *event) {
-    sem_wait(&queue->lock);  
+    lock_acquire(&queue->lock);  
 
-    EventNode *new_node = (EventNode *)malloc(sizeof(EventNode));
+    EventNode *new_node = queue->free_nodes;
+    if (new_node) {
+        queue->free_nodes = new_node->next;
+    } else {
+        new_node = (EventNode *)malloc(sizeof(EventNode));
+    }
     new_node->event = *event;
     new_node->next = NULL;
 
-    if (!queue->head || event->priority > queue->head->event.priority) {
+    // The new node goes after the last node of the lowest priority band that is not below its own
+    int level = event_priority_level(event->priority);
+    EventNode *previous = NULL;
+    for (int i = level; i < PRIORITY_LEVELS && !previous; i++) {
+        previous = queue->tails[i];
+    }
+
+    if (!previous) {
         new_node->next = queue->head;
         queue->head = new_node;
     } else {
-        EventNode *current = queue->head;
-        while (current->next && current->next->event.priority >= event->priority) {
-            current = current->next;
-        }
-        new_node->next = current->next;
-        current->next = new_node;
+        new_node->next = previous->next;
+        previous->next = new_node;
     }
+    queue->tails[level] = new_node;
 
     queue->size++;
-    sem_post(&queue->lock);  
+    lock_release(&queue->lock);  
 }
 
 /**
  * Pops an `Event` from the `EventQueue`.
  *
  * Removes the highest priority event from the queue in a thread-safe manner.
+ * The node is kept on the queue's free list for the next push.
  *
  * @param[in,out] queue  Pointer to the `EventQueue`.
  * @param[out]    event  Pointer to the `Event` structure to store the popped event.
  * @return               Non-zero if an event was successfully popped; zero otherwise.
  */
 int event_queue_pop(EventQueue *queue, Event *event) {
-    sem_wait(&queue->lock);  
+    lock_acquire(&queue->lock);  
 
     if (!queue->head) {
-        sem_post(&queue->lock);  
+        lock_release(&queue->lock);  
         return 0;
     }
 
     EventNode *to_remove = queue->head;
     *event = to_remove->event;
     queue->head = queue->head->next;
-    free(to_remove);
+
+    int level = event_priority_level(to_remove->event.priority);
+    if (queue->tails[level] == to_remove) {
+        queue->tails[level] = NULL;
+    }
+    to_remove->next = queue->free_nodes;
+    queue->free_nodes = to_remove;
     queue->size--;
 
-    sem_post(&queue->lock);  
+    lock_release(&queue->lock);  
     return 1;
 }
 
+/**
+ * Maps an event priority onto the index of its band in `EventQueue.tails`.
+ *
+ * Priorities outside of the known range are ordered together with the nearest band.
+ *
+ * @param[in] priority  Priority of the event.
+ * @return              Index into `EventQueue.tails`.
+ */
+static int event_priority_level(int priority) {
+    if (priority < 0) {
+        return 0;
+    }
+    if (priority >= PRIORITY_LEVELS) {
+        return PRIORITY_LEVELS - 1;
+    }
+    return priority;
+}
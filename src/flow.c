@@ -0,0 +1,284 @@
+#include "defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FLOW_UNBOUNDED 1e300   // Level and capacity of the placeholder resource used by systems with no input or output
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static void flow_model_derivative(FlowModel *model, const double *levels, double *derivative);
+static double flow_status_speed(int status);
+static double flow_clamp_unit(double value);
+static void flow_model_report_thresholds(FlowModel *model, Manager *manager);
+
+/**
+ * Initializes a `FlowModel` from the systems and resources of a `Manager`.
+ *
+ * Each system becomes a rate process completing `1 / processing_time` cycles per millisecond at STANDARD speed,
+ * an aggregated system moving the units of all of its copies each cycle.
+ * Resource arrays hold one extra placeholder slot (index `resource_count`) which is never empty and never full,
+ * systems without an input or output point at it so the integration loops need no branches.
+ *
+ * @param[out] model    Pointer to the `FlowModel` to initialize.
+ * @param[in]  manager  Pointer to the `Manager` whose simulation is modelled.
+ */
+void flow_model_init(FlowModel *model, Manager *manager) {
+    int systems = manager->system_array.size;
+    int resources = manager->resource_array.size;
+    int slots = resources + 1;
+
+    model->system_count = systems;
+    model->resource_count = resources;
+    model->time = 0.0;
+
+    model->consumed_ids = (int *)malloc(sizeof(int) * (systems > 0 ? systems : 1));
+    model->produced_ids = (int *)malloc(sizeof(int) * (systems > 0 ? systems : 1));
+    model->consumed_units = (double *)malloc(sizeof(double) * (systems > 0 ? systems : 1));
+    model->produced_units = (double *)malloc(sizeof(double) * (systems > 0 ? systems : 1));
+    model->cycle_rates = (double *)malloc(sizeof(double) * (systems > 0 ? systems : 1));
+    model->speeds = (double *)malloc(sizeof(double) * (systems > 0 ? systems : 1));
+    model->activity = (double *)malloc(sizeof(double) * (systems > 0 ? systems : 1));
+
+    model->levels = (double *)malloc(sizeof(double) * slots);
+    model->capacities = (double *)malloc(sizeof(double) * slots);
+    model->level_status = (int *)malloc(sizeof(int) * slots);
+    model->first_consumer = (int *)malloc(sizeof(int) * slots);
+    model->first_producer = (int *)malloc(sizeof(int) * slots);
+    model->stage = (double *)malloc(sizeof(double) * slots);
+    for (int i = 0; i < 4; i++) {
+        model->k[i] = (double *)malloc(sizeof(double) * slots);
+    }
+
+    for (int r = 0; r < resources; r++) {
+        Resource *resource = manager->resource_array.resources[r];
+        model->levels[r] = resource->amount;
+        model->capacities[r] = resource->max_capacity;
+        model->level_status[r] = STATUS_OK;
+        model->first_consumer[r] = -1;
+        model->first_producer[r] = -1;
+    }
+    model->levels[resources] = FLOW_UNBOUNDED;
+    model->capacities[resources] = 2 * FLOW_UNBOUNDED;
+    model->level_status[resources] = STATUS_OK;
+    model->first_consumer[resources] = -1;
+    model->first_producer[resources] = -1;
+
+    for (int s = 0; s < systems; s++) {
+        System *system = manager->system_array.systems[s];
+        int processing_time = (system->processing_time > 0) ? system->processing_time : 1;
+
+        if (system->consumed.resource && system->consumed.amount > 0) {
+            model->consumed_ids[s] = system->consumed.resource->id;
+            model->consumed_units[s] = (double)system->consumed.amount * system->multiplicity;
+            if (model->first_consumer[system->consumed.resource->id] < 0) {
+                model->first_consumer[system->consumed.resource->id] = s;
+            }
+        } else {
+            model->consumed_ids[s] = resources;
+            model->consumed_units[s] = 1.0;
+        }
+
+        if (system->produced.resource && system->produced.amount > 0) {
+            model->produced_ids[s] = system->produced.resource->id;
+            model->produced_units[s] = (double)system->produced.amount * system->multiplicity;
+            if (model->first_producer[system->produced.resource->id] < 0) {
+                model->first_producer[system->produced.resource->id] = s;
+            }
+        } else {
+            model->produced_ids[s] = resources;
+            model->produced_units[s] = 1.0;
+        }
+
+        model->cycle_rates[s] = 1.0 / processing_time;
+        model->speeds[s] = flow_status_speed(system_speed(system));
+    }
+}
+
+/**
+ * Cleans up a `FlowModel`, freeing all of its arrays.
+ *
+ * @param[in,out] model  Pointer to the `FlowModel` to clean.
+ */
+void flow_model_clean(FlowModel *model) {
+    free(model->consumed_ids);
+    free(model->produced_ids);
+    free(model->consumed_units);
+    free(model->produced_units);
+    free(model->cycle_rates);
+    free(model->speeds);
+    free(model->activity);
+    free(model->levels);
+    free(model->capacities);
+    free(model->level_status);
+    free(model->first_consumer);
+    free(model->first_producer);
+    free(model->stage);
+    for (int i = 0; i < 4; i++) {
+        free(model->k[i]);
+    }
+}
+
+/**
+ * Advances a `FlowModel` by `dt` milliseconds with one classic RK4 step.
+ *
+ * Levels are clamped to [0, max_capacity] and threshold crossings are pushed onto the event queue
+ * as the systems would have reported them, unless the manager finds them itself with a threshold scan.
+ * Use `flow_model_sync` to exchange levels and statuses with the `Manager`.
+ *
+ * @param[in,out] model    Pointer to the `FlowModel`.
+ * @param[in,out] manager  Pointer to the `Manager` the model was created from.
+ * @param[in]     dt       Step size in milliseconds.
+ */
+void flow_model_step(FlowModel *model, Manager *manager, double dt) {
+    int slots = model->resource_count + 1;
+    double *restrict levels = model->levels;
+    double *restrict stage = model->stage;
+    double *restrict k0 = model->k[0];
+    double *restrict k1 = model->k[1];
+    double *restrict k2 = model->k[2];
+    double *restrict k3 = model->k[3];
+
+    flow_model_derivative(model, levels, k0);
+    for (int r = 0; r < slots; r++) {
+        stage[r] = levels[r] + 0.5 * dt * k0[r];
+    }
+    flow_model_derivative(model, stage, k1);
+    for (int r = 0; r < slots; r++) {
+        stage[r] = levels[r] + 0.5 * dt * k1[r];
+    }
+    flow_model_derivative(model, stage, k2);
+    for (int r = 0; r < slots; r++) {
+        stage[r] = levels[r] + dt * k2[r];
+    }
+    flow_model_derivative(model, stage, k3);
+
+    const double *restrict capacities = model->capacities;
+    for (int r = 0; r < slots; r++) {
+        double level = levels[r] + dt / 6.0 * (k0[r] + 2.0 * k1[r] + 2.0 * k2[r] + k3[r]);
+        level = (level < 0.0) ? 0.0 : level;
+        levels[r] = (level > capacities[r]) ? capacities[r] : level;
+    }
+    levels[model->resource_count] = FLOW_UNBOUNDED;
+    model->time += dt;
+
+    if (!manager->scan) {
+        flow_model_report_thresholds(model, manager);
+    }
+}
+
+/**
+ * Exchanges state between a `FlowModel` and the `Manager` it was created from.
+ *
+ * Copies the integrated levels into the `Resource` amounts and re-reads every system's status,
+ * so the manager's decisions take effect from the next step. Kept out of `flow_model_step` because it touches
+ * every `System` and `Resource`, call it whenever the manager is about to look at or has changed the simulation.
+ *
+ * @param[in,out] model    Pointer to the `FlowModel`.
+ * @param[in,out] manager  Pointer to the `Manager` the model was created from.
+ */
+void flow_model_sync(FlowModel *model, Manager *manager) {
+    for (int r = 0; r < model->resource_count; r++) {
+        manager->resource_array.resources[r]->amount = (int)model->levels[r];
+    }
+
+    for (int s = 0; s < model->system_count; s++) {
+        model->speeds[s] = flow_status_speed(system_speed(manager->system_array.systems[s]));
+    }
+}
+
+/**
+ * Computes the rate of change of every resource level.
+ *
+ * A system runs at full speed while one cycle's worth of input is available and one cycle's worth of space
+ * is left in its output, and slows down linearly below that, which keeps levels from overshooting 0 or capacity.
+ * The first loop only gathers and multiplies so it vectorizes; the second scatters the flows onto the resources.
+ *
+ * @param[in,out] model       Pointer to the `FlowModel` (its `activity` scratch array is overwritten).
+ * @param[in]     levels      Resource levels to evaluate at.
+ * @param[out]    derivative  Rate of change of each resource level, in units per millisecond.
+ */
+static void flow_model_derivative(FlowModel *model, const double *levels, double *derivative) {
+    const int *restrict consumed_ids = model->consumed_ids;
+    const int *restrict produced_ids = model->produced_ids;
+    const double *restrict consumed_units = model->consumed_units;
+    const double *restrict produced_units = model->produced_units;
+    const double *restrict cycle_rates = model->cycle_rates;
+    const double *restrict speeds = model->speeds;
+    const double *restrict capacities = model->capacities;
+    double *restrict activity = model->activity;
+
+    for (int s = 0; s < model->system_count; s++) {
+        double input = flow_clamp_unit(levels[consumed_ids[s]] / consumed_units[s]);
+        double output = flow_clamp_unit((capacities[produced_ids[s]] - levels[produced_ids[s]]) / produced_units[s]);
+        activity[s] = cycle_rates[s] * speeds[s] * input * output;
+    }
+
+    memset(derivative, 0, sizeof(double) * (model->resource_count + 1));
+    for (int s = 0; s < model->system_count; s++) {
+        derivative[consumed_ids[s]] -= activity[s] * consumed_units[s];
+        derivative[produced_ids[s]] += activity[s] * produced_units[s];
+    }
+}
+
+/**
+ * Pushes an event for every resource whose threshold status changed during the last step.
+ *
+ * Only crossings are reported (becoming empty, low or full), a resource which stays low sends a single event.
+ * The event is attributed to a consumer of the resource, or to a producer when the resource is at capacity.
+ *
+ * @param[in,out] model    Pointer to the `FlowModel`.
+ * @param[in,out] manager  Pointer to the `Manager` whose event queue receives the events.
+ */
+static void flow_model_report_thresholds(FlowModel *model, Manager *manager) {
+    Event event;
+
+    for (int r = 0; r < model->resource_count; r++) {
+        double level = model->levels[r];
+        double capacity = model->capacities[r];
+        int status = STATUS_OK;
+
+        if (level < 1.0) {
+            status = STATUS_EMPTY;
+        } else if (level < capacity * THRESHOLD_RESOURCE_LOW) {
+            status = STATUS_LOW;
+        } else if (level > capacity - 1.0) {
+            status = STATUS_CAPACITY;
+        }
+
+        if (status == model->level_status[r]) {
+            continue;
+        }
+        model->level_status[r] = status;
+
+        int source = (status == STATUS_CAPACITY) ? model->first_producer[r] : model->first_consumer[r];
+        if (status == STATUS_OK || source < 0) {
+            continue;
+        }
+
+        event_init(&event, manager->system_array.systems[source], manager->resource_array.resources[r], status,
+                   (status == STATUS_CAPACITY) ? PRIORITY_LOW : PRIORITY_HIGH, (int)level);
+        event_queue_push(&manager->event_queue, &event);
+    }
+}
+
+/**
+ * Converts a system status into the multiplier applied to its cycle rate.
+ *
+ * @param[in] status  Status of the system.
+ * @return            Speed multiplier (0 when the system is not running).
+ */
+static double flow_status_speed(int status) {
+    switch (status) {
+        case SLOW: return 0.5;
+        case STANDARD: return 1.0;
+        case FAST: return 2.0;
+        default: return 0.0;
+    }
+}
+
+static double flow_clamp_unit(double value) {
+    value = (value < 0.0) ? 0.0 : value;
+    return (value > 1.0) ? 1.0 : value;
+}
@@ -0,0 +1,353 @@
+#include "defs.h"
+#include <stdlib.h>
+#include <string.h>
+
+// File format, all values in host byte order:
+//   header   JOURNAL_MAGIC, resource count, system count (int32 each)
+//   frames   JOURNAL_TAG_SNAPSHOT, time (double), resource amounts, system stored amounts, system statuses (int32 each)
+//            JOURNAL_TAG_RECORDS, record count (uint32), `JournalRecord`s
+//   footer   one `JournalIndexEntry` per snapshot, then the index offset and entry count (int64 each) and JOURNAL_MAGIC
+#define JOURNAL_MAGIC "RSJRNL1"
+#define JOURNAL_TAG_SNAPSHOT 0x50414E53u   // "SNAP"
+#define JOURNAL_TAG_RECORDS  0x53434552u   // "RECS"
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static void journal_write(Journal *journal, const void *data, size_t size, size_t count);
+static void journal_flush(Journal *journal);
+static void journal_apply(SimState *state, const JournalRecord *record);
+
+/**
+ * Opens a `Journal` writing to `path` and records the initial state of the simulation as its first snapshot.
+ *
+ * Systems only record while their `journal` pointer is set, and the manager only takes snapshots while its
+ * `journal` is set; the caller sets both once the journal is open.
+ *
+ * @param[out] journal  Pointer to the `Journal` to open.
+ * @param[in]  path     File to create (truncated if it exists).
+ * @param[in]  manager  Pointer to the `Manager` whose simulation is recorded.
+ * @return              0 on success, -1 if the file could not be created.
+ */
+int journal_open(Journal *journal, const char *path, Manager *manager) {
+    int32_t header[2];
+
+    journal->file = fopen(path, "wb");
+    if (!journal->file) {
+        return -1;
+    }
+
+    lock_init(&journal->lock);
+    clock_gettime(CLOCK_MONOTONIC, &journal->start);
+    journal->virtual_time = 0;
+    journal->time = 0.0;
+    journal->snapshot_time = 0.0;
+    journal->resource_count = manager->resource_array.size;
+    journal->system_count = manager->system_array.size;
+    journal->buffer = (JournalRecord *)malloc(sizeof(JournalRecord) * JOURNAL_BUFFER_RECORDS);
+    journal->buffered = 0;
+    journal->index = (JournalIndexEntry *)malloc(sizeof(JournalIndexEntry) * 1);
+    journal->index_count = 0;
+    journal->index_capacity = 1;
+    journal->records = 0;
+    journal->failed = 0;
+
+    header[0] = journal->resource_count;
+    header[1] = journal->system_count;
+    journal_write(journal, JOURNAL_MAGIC, 1, sizeof(JOURNAL_MAGIC));
+    journal_write(journal, header, sizeof(int32_t), 2);
+
+    journal_snapshot(journal, manager);
+    return 0;
+}
+
+/**
+ * Writes the remaining records and the snapshot index, then closes the `Journal` and frees its memory.
+ *
+ * Every system and the manager must have stopped recording first.
+ *
+ * @param[in,out] journal  Pointer to the `Journal` to close.
+ * @return                 0 on success, -1 if any write since `journal_open` failed (the file is incomplete).
+ */
+int journal_close(Journal *journal) {
+    int64_t trailer[2];
+
+    lock_acquire(&journal->lock);
+    journal_flush(journal);
+    trailer[0] = (int64_t)ftell(journal->file);
+    trailer[1] = journal->index_count;
+    journal_write(journal, journal->index, sizeof(JournalIndexEntry), journal->index_count);
+    journal_write(journal, trailer, sizeof(int64_t), 2);
+    journal_write(journal, JOURNAL_MAGIC, 1, sizeof(JOURNAL_MAGIC));
+    if (fclose(journal->file) != 0) {
+        journal->failed = 1;   // The last buffered bytes are only written here
+    }
+    journal->file = NULL;
+    lock_release(&journal->lock);
+
+    lock_destroy(&journal->lock);
+    free(journal->buffer);
+    free(journal->index);
+    return journal->failed ? -1 : 0;
+}
+
+/**
+ * Returns the current journal time.
+ *
+ * @param[in] journal  Pointer to the `Journal`.
+ * @return             Milliseconds since the journal was opened, or `time` when `virtual_time` is set.
+ */
+double journal_now(Journal *journal) {
+    struct timespec now;
+
+    if (journal->virtual_time) {
+        return journal->time;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - journal->start.tv_sec) * 1000.0 + (now.tv_nsec - journal->start.tv_nsec) / 1e6;
+}
+
+/**
+ * Appends one change to the `Journal`.
+ *
+ * Callers record a resource while still holding its lock, so the records of each resource are in the order
+ * the changes were made. The time is read under the journal lock, so records are also in time order.
+ *
+ * @param[in,out] journal  Pointer to the `Journal`.
+ * @param[in]     kind     JOURNAL_ kind of the change.
+ * @param[in]     id       Id of the resource or system which changed.
+ * @param[in]     value    New amount or status.
+ */
+void journal_record(Journal *journal, int kind, int id, int value) {
+    lock_acquire(&journal->lock);
+
+    JournalRecord *record = &journal->buffer[journal->buffered++];
+    double offset_us = (journal_now(journal) - journal->snapshot_time) * 1000.0;
+    if (offset_us < 0.0) {
+        offset_us = 0.0;
+    } else if (offset_us > UINT32_MAX) {
+        offset_us = UINT32_MAX;
+    }
+    record->offset_us = (uint32_t)offset_us;
+    record->kind_id = ((uint32_t)id << JOURNAL_KIND_BITS) | (uint32_t)kind;
+    record->value = value;
+
+    if (journal->buffered == JOURNAL_BUFFER_RECORDS) {
+        journal_flush(journal);
+    }
+    lock_release(&journal->lock);
+}
+
+/**
+ * Writes a full snapshot of the simulation to the `Journal` and adds it to the index,
+ * growing the index if necessary (doubling the size).
+ *
+ * Amounts are read without the resource locks. This is safe because records hold absolute values: a change
+ * the snapshot already contains but which is recorded after it is simply applied again with the same value.
+ * Use of realloc is NOT permitted.
+ *
+ * @param[in,out] journal  Pointer to the `Journal`.
+ * @param[in]     manager  Pointer to the `Manager` whose simulation is recorded.
+ */
+void journal_snapshot(Journal *journal, Manager *manager) {
+    uint32_t tag = JOURNAL_TAG_SNAPSHOT;
+
+    lock_acquire(&journal->lock);
+    journal_flush(journal);
+
+    if (journal->index_count == journal->index_capacity) {
+        journal->index_capacity *= 2;
+        JournalIndexEntry *new_index = (JournalIndexEntry *)malloc(sizeof(JournalIndexEntry) * journal->index_capacity);
+        for (int i = 0; i < journal->index_count; i++) {
+            new_index[i] = journal->index[i];
+        }
+        free(journal->index);
+        journal->index = new_index;
+    }
+
+    JournalIndexEntry *entry = &journal->index[journal->index_count++];
+    entry->time = journal_now(journal);
+    entry->offset = (int64_t)ftell(journal->file);
+    journal->snapshot_time = entry->time;
+
+    journal_write(journal, &tag, sizeof(tag), 1);
+    journal_write(journal, &entry->time, sizeof(double), 1);
+    for (int i = 0; i < journal->resource_count; i++) {
+        int32_t amount = __atomic_load_n(&manager->resource_array.resources[i]->amount, __ATOMIC_RELAXED);
+        journal_write(journal, &amount, sizeof(amount), 1);
+    }
+    for (int i = 0; i < journal->system_count; i++) {
+        int32_t stored = __atomic_load_n(&manager->system_array.systems[i]->amount_stored, __ATOMIC_RELAXED);
+        journal_write(journal, &stored, sizeof(stored), 1);
+    }
+    for (int i = 0; i < journal->system_count; i++) {
+        int32_t status = __atomic_load_n(&manager->system_array.systems[i]->status, __ATOMIC_RELAXED);
+        journal_write(journal, &status, sizeof(status), 1);
+    }
+
+    lock_release(&journal->lock);
+}
+
+/**
+ * Writes `count` items of `size` bytes to the journal file. A short write marks the journal as failed, which
+ * `journal_close` reports; recording goes on, since the threads appending cannot stop the simulation.
+ * Must be called with the journal locked.
+ */
+static void journal_write(Journal *journal, const void *data, size_t size, size_t count) {
+    if (fwrite(data, size, count, journal->file) != count) {
+        journal->failed = 1;
+    }
+}
+
+/**
+ * Writes the buffered records as one frame. Must be called with the journal locked.
+ *
+ * @param[in,out] journal  Pointer to the `Journal`.
+ */
+static void journal_flush(Journal *journal) {
+    uint32_t header[2] = {JOURNAL_TAG_RECORDS, (uint32_t)journal->buffered};
+
+    if (journal->buffered == 0) {
+        return;
+    }
+    journal_write(journal, header, sizeof(uint32_t), 2);
+    journal_write(journal, journal->buffer, sizeof(JournalRecord), journal->buffered);
+    journal->records += journal->buffered;
+    journal->buffered = 0;
+}
+
+/**
+ * Reconstructs the state of a recorded simulation at any time.
+ *
+ * Finds the latest snapshot at or before `time` with a binary search of the index, loads it, and replays
+ * only the records which follow it up to `time`. At most `JOURNAL_SNAPSHOT_INTERVAL` of records are read,
+ * however long the recording.
+ *
+ * @param[in]  path           Journal file written by `journal_close`.
+ * @param[in]  time           Milliseconds since the start of the recording.
+ * @param[out] state          `SimState` to initialize with the state at `time`; clean it with `sim_state_clean`.
+ * @param[out] snapshot_time  Time of the snapshot the state was rebuilt from (may be NULL).
+ * @param[out] replayed       Number of records replayed on top of the snapshot (may be NULL).
+ * @return                    0 on success, -1 if the file is missing, truncated or not a journal.
+ */
+int journal_seek(const char *path, double time, SimState *state, double *snapshot_time, long *replayed) {
+    char magic[sizeof(JOURNAL_MAGIC)];
+    int32_t header[2];
+    int64_t trailer[2];
+    uint32_t tag;
+    double base_time;
+    long applied = 0;
+    FILE *file = fopen(path, "rb");
+
+    if (!file) {
+        return -1;
+    }
+
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0 ||
+        fread(header, sizeof(int32_t), 2, file) != 2 ||
+        fseek(file, -(long)(sizeof(trailer) + sizeof(magic)), SEEK_END) != 0 ||
+        fread(trailer, sizeof(int64_t), 2, file) != 2 ||
+        fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0 ||
+        trailer[1] <= 0) {
+        fclose(file);
+        return -1;
+    }
+
+    // Latest snapshot at or before `time`, the first one if `time` precedes it
+    int64_t low = 0, high = trailer[1] - 1;
+    JournalIndexEntry entry;
+    while (low < high) {
+        int64_t middle = (low + high + 1) / 2;
+        fseek(file, (long)(trailer[0] + middle * (int64_t)sizeof(JournalIndexEntry)), SEEK_SET);
+        if (fread(&entry, sizeof(entry), 1, file) != 1) {
+            fclose(file);
+            return -1;
+        }
+        if (entry.time <= time) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    fseek(file, (long)(trailer[0] + low * (int64_t)sizeof(JournalIndexEntry)), SEEK_SET);
+    if (fread(&entry, sizeof(entry), 1, file) != 1 || fseek(file, (long)entry.offset, SEEK_SET) != 0 ||
+        fread(&tag, sizeof(tag), 1, file) != 1 || tag != JOURNAL_TAG_SNAPSHOT ||
+        fread(&base_time, sizeof(double), 1, file) != 1) {
+        fclose(file);
+        return -1;
+    }
+
+    persistent_array_init(&state->resource_amounts, header[0]);
+    persistent_array_init(&state->system_stored, header[1]);
+    persistent_array_init(&state->system_status, header[1]);
+    PersistentArray *arrays[3] = {&state->resource_amounts, &state->system_stored, &state->system_status};
+    for (int a = 0; a < 3; a++) {
+        for (int i = 0; i < arrays[a]->size; i++) {
+            int32_t value = 0;
+            if (fread(&value, sizeof(value), 1, file) != 1) {
+                sim_state_clean(state);
+                fclose(file);
+                return -1;
+            }
+            persistent_array_set(arrays[a], i, value);
+        }
+    }
+
+    // Replay the records of the following frames until one is later than `time` or the next snapshot is reached
+    JournalRecord *records = (JournalRecord *)malloc(sizeof(JournalRecord) * JOURNAL_BUFFER_RECORDS);
+    uint32_t limit_us = (time - base_time) * 1000.0 >= UINT32_MAX ? UINT32_MAX : (uint32_t)((time - base_time) * 1000.0);
+    int done = (time < base_time);
+    while (!done && ftell(file) < trailer[0] && fread(&tag, sizeof(tag), 1, file) == 1 && tag == JOURNAL_TAG_RECORDS) {
+        uint32_t count;
+        if (fread(&count, sizeof(count), 1, file) != 1) {
+            break;
+        }
+        while (count > 0 && !done) {
+            uint32_t chunk = (count < JOURNAL_BUFFER_RECORDS) ? count : JOURNAL_BUFFER_RECORDS;
+            if (fread(records, sizeof(JournalRecord), chunk, file) != chunk) {
+                done = 1;
+                break;
+            }
+            for (uint32_t i = 0; i < chunk; i++) {
+                if (records[i].offset_us > limit_us) {
+                    done = 1;
+                    break;
+                }
+                journal_apply(state, &records[i]);
+                applied++;
+            }
+            count -= chunk;
+        }
+    }
+    free(records);
+    fclose(file);
+
+    if (snapshot_time) {
+        *snapshot_time = base_time;
+    }
+    if (replayed) {
+        *replayed = applied;
+    }
+    return 0;
+}
+
+/**
+ * Applies one record to a `SimState`, ignoring ids outside the recorded simulation.
+ *
+ * @param[in,out] state   Pointer to the `SimState` being rebuilt.
+ * @param[in]     record  Pointer to the `JournalRecord`.
+ */
+static void journal_apply(SimState *state, const JournalRecord *record) {
+    int kind = record->kind_id & ((1u << JOURNAL_KIND_BITS) - 1);
+    int id = (int)(record->kind_id >> JOURNAL_KIND_BITS);
+    PersistentArray *array = NULL;
+
+    switch (kind) {
+        case JOURNAL_RESOURCE: array = &state->resource_amounts; break;
+        case JOURNAL_STORED: array = &state->system_stored; break;
+        case JOURNAL_STATUS: array = &state->system_status; break;
+    }
+    if (array && id < array->size) {
+        persistent_array_set(array, id, record->value);
+    }
+}
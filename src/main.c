@@ -1,78 +1,587 @@
 #include "defs.h"
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
 
-void load_data(Manager *manager);
+#define MAX_WEIGHT_OPTIONS 16   // --weight settings accepted on one command line
+
+// Command line options for a run of the simulation
+typedef struct Options {
+    uint64_t seed;      // Seed for the systems' random streams
+    int stochastic;     // non-zero to give the sample systems randomly varying processing times
+    int headless;       // non-zero to run without drawing the simulation in the terminal
+    int scale;          // Number of copies of the sample data to load
+    int continuous;     // non-zero to integrate the simulation as continuous flows instead of running threads
+    double dt;          // Step size in milliseconds for the continuous mode
+    double duration;    // Maximum simulated milliseconds for the continuous mode
+    int backoff;        // BACKOFF_ strategy used by every system when a step fails
+    int metrics;        // non-zero to print the system metrics when the simulation ends
+    int predictive;     // non-zero to let the manager act on forecast resource crossings
+    int reserve;        // non-zero to make every system reserve its output space before processing
+    int scan;           // non-zero to let the manager scan resource thresholds instead of receiving events
+    int group_control;  // non-zero to change producer speeds with one write per resource
+    int crew;           // Crew members per capsule in the sample data
+    int aggregate;      // non-zero to merge identical systems into one system with a multiplicity
+    const char *record; // Journal file to record the threaded run to, NULL for none
+    const char *seek;   // Journal file to rebuild a past state from instead of running, NULL for none
+    double seek_time;   // Milliseconds into the recording of the state to rebuild
+    int workers;        // Manager workers applying speed changes in parallel, zero for none
+    const char *profile; // File to write the sampled folded stacks to, NULL to run without the profiler
+    int profile_hz;     // Samples per second of thread CPU time
+    double alloc_warmup; // Milliseconds of the run after which every allocation is reported, negative for no check
+    const char *trace;  // Trace file to record the events handled by the manager to, NULL for none
+    const char *replay; // Trace file to replay through the manager's decisions instead of running, NULL for none
+    int replay_rounds;  // Timed replays of the trace
+    const char *policy; // Policy plugin deciding instead of the built-in policy, NULL for the built-in one
+    const char *control; // Unix domain socket to accept control commands on, NULL for none
+    int dashboard;      // Port of the web dashboard on 127.0.0.1, negative for none
+    const char *weights[MAX_WEIGHT_OPTIONS]; // NAME:W settings of system weights
+    int weight_count;
+} Options;
+
+void parse_options(Options *options, int argc, char *argv[]);
+int seek_journal(Manager *manager, const Options *options);
+int replay_trace(Manager *manager, const Options *options);
+void run_threads(Manager *manager);
+void run_continuous(Manager *manager, const Options *options);
+void run_simulation(Manager *manager, Options *options);
+
+int main(int argc, char *argv[]) {
+    Options options;
+    parse_options(&options, argc, argv);
 
-int main(void) {
     Manager manager;
     manager_init(&manager);
-    load_data(&manager);
+    manager.display_enabled = !options.headless;
+    manager.predictive = options.predictive;
+    manager.scan = options.scan;
+    manager.group_control = options.group_control;
+    for (int i = 0; i < options.scale; i++) {
+        load_data(&manager);
+    }
+    if (options.stochastic) {
+        load_distributions(&manager);
+    }
+    load_crew(&manager, options.crew);
+    if (options.aggregate) {
+        int merged = manager_aggregate(&manager);
+        printf("Aggregated %d identical systems, %d systems left\n", merged, manager.system_array.size);
+    }
+    if (manager_prune(&manager) > 0) {
+        for (int i = 0; i < manager.system_array.size; i++) {
+            System *system = manager.system_array.systems[i];
+            if (system->parked) {
+                printf("Parked %s: %s can never be supplied\n", system->name, system->consumed.resource->name);
+            }
+        }
+    }
+    manager_seed(&manager, options.seed);
+    for (int i = 0; i < manager.system_array.size; i++) {
+        manager.system_array.systems[i]->backoff_strategy = options.backoff;
+        manager.system_array.systems[i]->reserve_output = options.reserve;
+        manager.system_array.systems[i]->silent = options.scan;
+    }
+    for (int w = 0; w < options.weight_count; w++) {
+        const char *separator = strrchr(options.weights[w], ':');
+        char *end = NULL;
+        long weight = separator ? strtol(separator + 1, &end, 10) : 0;
+        if (!separator || end == separator + 1 || *end != '\0' || weight < 1 || weight > INT_MAX) {
+            fprintf(stderr, "--weight needs NAME:WEIGHT with a positive integer weight, got %s\n", options.weights[w]);
+            manager_clean(&manager);
+            return 1;
+        }
+        int named = 0;
+        for (int i = 0; i < manager.system_array.size; i++) {
+            System *system = manager.system_array.systems[i];
+            if (strncmp(system->name, options.weights[w], separator - options.weights[w]) == 0 &&
+                system->name[separator - options.weights[w]] == '\0') {
+                system->weight = (int)weight;
+                named++;
+            }
+        }
+        if (named == 0) {
+            fprintf(stderr, "No system matches --weight %s\n", options.weights[w]);
+        }
+    }
 
-    pthread_t manager_t;
-    pthread_t system_threads[manager.system_array.size];
+    if (options.seek) {
+        int result = seek_journal(&manager, &options);
+        manager_clean(&manager);
+        return result;
+    }
+
+    PolicyPlugin policy;
+    if (options.policy) {
+        const char *error;
+        if (policy_load(&policy, options.policy, &manager, &error) != 0) {
+            fprintf(stderr, "Cannot load policy %s: %s\n", options.policy, error);
+            manager_clean(&manager);
+            return 1;
+        }
+        manager.policy = &policy;
+        printf("Policy: %s from %s\n", policy.policy->name, options.policy);
+    }
 
-    pthread_create(&manager_t, NULL, manager_thread, &manager);
+    if (options.replay) {
+        int result = replay_trace(&manager, &options);
+        if (manager.policy) {
+            policy_unload(&policy);
+        }
+        manager_clean(&manager);
+        return result;
+    }
 
-    for (int i = 0; i < manager.system_array.size; ++i) {
-        pthread_create(&system_threads[i], NULL, system_thread, manager.system_array.systems[i]);
+    // From here on a failure skips the run but still goes through the cleanup at the end,
+    // which closes whatever output was opened and unloads the policy
+    int result = 0;
+    Journal journal;
+    if (options.record) {
+        if (journal_open(&journal, options.record, &manager) != 0) {
+            fprintf(stderr, "Cannot create %s\n", options.record);
+            result = 1;
+        } else {
+            manager.journal = &journal;
+            for (int i = 0; i < manager.system_array.size; i++) {
+                manager.system_array.systems[i]->journal = &journal;
+            }
+        }
     }
 
-    pthread_join(manager_t, NULL);
-    for (int i = 0; i < manager.system_array.size; ++i) {
-        pthread_join(system_threads[i], NULL);
+    Trace trace;
+    if (options.trace && result == 0) {
+        if (trace_open(&trace, options.trace, &manager) != 0) {
+            fprintf(stderr, "Cannot create %s\n", options.trace);
+            result = 1;
+        } else {
+            manager.trace = &trace;
+        }
+    }
+
+    if (result == 0) {
+        run_simulation(&manager, &options);
+    }
+
+    if (manager.journal) {
+        if (journal_close(&journal) != 0) {
+            fprintf(stderr, "Cannot write %s, the recording is incomplete\n", options.record);
+            result = 1;
+        } else {
+            printf("Recorded %ld changes and %d snapshots to %s\n", journal.records, journal.index_count,
+                   options.record);
+        }
+    }
+
+    if (manager.trace) {
+        manager.trace = NULL;
+        if (trace_close(&trace) != 0) {
+            fprintf(stderr, "Cannot write %s, the trace is incomplete\n", options.trace);
+            result = 1;
+        } else {
+            printf("Traced %ld events to %s\n", trace.records, options.trace);
+        }
+    }
+
+    if (options.metrics) {
+        manager_print_metrics(&manager);
+    }
+
+    if (manager.policy) {
+        printf("Policy %s: %ld batches, %ld decisions applied, %ld rejected\n", policy.policy->name, policy.batches,
+               policy.applied, policy.rejected);
+        manager.policy = NULL;
+        policy_unload(&policy);
+    }
+
+    if (options.alloc_warmup >= 0.0 && alloc_tracking_enabled()) {
+        long late = alloc_tracking_report(stdout);
+        printf("%ld allocations after the %.0f ms warm-up\n", late, options.alloc_warmup);
+        result |= late > 0;
     }
 
     manager_clean(&manager);
+    return result;
+}
+
+/**
+ * Runs the loaded simulation, threaded or continuous, with the profiler, control socket and dashboard asked for.
+ * Those that cannot start are reported and left out; the run goes on without them.
+ *
+ * @param[in,out] manager  Pointer to the `Manager` holding the loaded simulation, with its journal and trace set.
+ * @param[in,out] options  Pointer to the `Options`; a part that cannot start is cleared in them.
+ */
+void run_simulation(Manager *manager, Options *options) {
+    Profiler profiler;
+    if (options->profile && profiler_start(&profiler, options->profile_hz) != 0) {
+        fprintf(stderr, "Cannot install the profiler\n");
+        options->profile = NULL;
+    }
+
+    Control control;
+    if (options->control) {
+        if (control_start(&control, options->control, manager) != 0) {
+            fprintf(stderr, "Cannot listen on %s\n", options->control);
+            options->control = NULL;
+        } else {
+            printf("Control socket: %s\n", options->control);
+        }
+    }
+
+    Dashboard dashboard;
+    if (options->dashboard >= 0) {
+        if (dashboard_start(&dashboard, options->dashboard, manager) != 0) {
+            fprintf(stderr, "Cannot listen on port %d\n", options->dashboard);
+            options->dashboard = -1;
+        } else {
+            printf("Dashboard: http://127.0.0.1:%d/\n", dashboard.port);
+        }
+    }
+
+    if (options->alloc_warmup >= 0.0) {
+        alloc_tracking_start(options->alloc_warmup);
+    }
+    manager_start_workers(manager, options->workers);
+    if (options->continuous) {
+        profiler_thread_start(PROFILE_MANAGER);
+        run_continuous(manager, options);
+        profiler_thread_stop();
+    } else {
+        run_threads(manager);
+    }
+    manager_stop_workers(manager);
+
+    if (options->control) {
+        control_stop(&control);
+    }
+
+    if (options->dashboard >= 0) {
+        dashboard_stop(&dashboard);
+        printf("Dashboard: %ld frames, %ld bytes streamed, %ld clients dropped\n", dashboard.frames, dashboard.bytes,
+               dashboard.dropped);
+    }
+
+    if (options->profile) {
+        profiler_stop(&profiler);
+        profiler_write_folded(&profiler, options->profile);
+    }
+}
+
+/**
+ * Runs the simulation with one thread per system and one for the manager, until the manager stops it.
+ * Systems parked at load time get no thread.
+ *
+ * @param[in,out] manager  Pointer to the `Manager` holding the loaded simulation.
+ */
+void run_threads(Manager *manager) {
+    pthread_t manager_t;
+
+    pthread_create(&manager_t, NULL, manager_thread, manager);
+    manager_start_threads(manager);
+
+    pthread_join(manager_t, NULL);
+    manager_join_threads(manager);
+}
+
+/**
+ * Rebuilds the state of a recorded run at `options->seek_time` and prints it.
+ *
+ * The same scenario options as the recorded run must be given, so the resources and systems match the journal.
+ *
+ * @param[in,out] manager  Pointer to the `Manager` holding the loaded scenario, overwritten with the recorded state.
+ * @param[in]     options  Pointer to the parsed `Options`.
+ * @return                 Exit status of the program.
+ */
+int seek_journal(Manager *manager, const Options *options) {
+    SimState state;
+    double snapshot_time;
+    long replayed;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (journal_seek(options->seek, options->seek_time, &state, &snapshot_time, &replayed) != 0) {
+        fprintf(stderr, "Cannot read journal %s\n", options->seek);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (state.resource_amounts.size != manager->resource_array.size || state.system_stored.size != manager->system_array.size) {
+        fprintf(stderr, "Journal %s was recorded with %d resources and %d systems, the scenario has %d and %d\n",
+                options->seek, state.resource_amounts.size, state.system_stored.size,
+                manager->resource_array.size, manager->system_array.size);
+        sim_state_clean(&state);
+        return 1;
+    }
+    sim_state_restore(&state, manager);
+    sim_state_clean(&state);
+
+    printf("State at %.1f ms: snapshot at %.1f ms + %ld changes, found in %.3f ms\n", options->seek_time, snapshot_time,
+           replayed, (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6);
+    for (int i = 0; i < manager->resource_array.size; i++) {
+        Resource *resource = manager->resource_array.resources[i];
+        printf("%s: %d / %d\n", resource->name, resource->amount, resource->max_capacity);
+    }
+    for (int i = 0; i < manager->system_array.size; i++) {
+        System *system = manager->system_array.systems[i];
+        printf("%s: status %d, holding %d\n", system->name, system->status, system->amount_stored);
+    }
     return 0;
 }
 
 /**
- * Loads sample data for the simulation.
+ * Replays a recorded trace through the manager's decisions, single-threaded and as fast as possible, and prints
+ * the decision cost and a digest of the decisions.
  *
- * Calls all of the functions required to create resources and systems and add them to the Manager's data.
+ * The same scenario options as the traced run must be given, so the event ids match the loaded systems.
  *
- * @param[in,out] manager  Pointer to the `Manager` to populate with resource and system data.
+ * @param[in,out] manager  Pointer to the `Manager` holding the loaded scenario.
+ * @param[in]     options  Pointer to the parsed `Options`.
+ * @return                 Exit status of the program.
  */
-void load_data(Manager *manager) {
-    // Create resources
-    Resource *fuel, *oxygen, *energy, *distance;
-    resource_create(&fuel, "Fuel", 1000, 1000);
-    resource_create(&oxygen, "Oxygen", 20, 50);
-    resource_create(&energy, "Energy", 30, 50);
-    resource_create(&distance, "Distance", 0, 5000);
-
-    resource_array_add(&manager->resource_array, fuel);
-    resource_array_add(&manager->resource_array, oxygen);
-    resource_array_add(&manager->resource_array, energy);
-    resource_array_add(&manager->resource_array, distance);
-
-    // Create systems
-    System *propulsion_system, *life_support_system, *crew_capsule_system, *generator_system;
-    ResourceAmount consume_fuel, produce_distance;
-    resource_amount_init(&consume_fuel, fuel, 5);
-    resource_amount_init(&produce_distance, distance, 25);
-    system_create(&propulsion_system, "Propulsion", consume_fuel, produce_distance, 50, &manager->event_queue);
-
-    ResourceAmount consume_energy, produce_oxygen;
-    resource_amount_init(&consume_energy, energy, 7);
-    resource_amount_init(&produce_oxygen, oxygen, 4);
-    system_create(&life_support_system, "Life Support", consume_energy, produce_oxygen, 10, &manager->event_queue);
-
-    ResourceAmount consume_oxygen, produce_nothing;
-    resource_amount_init(&consume_oxygen, oxygen, 1);
-    resource_amount_init(&produce_nothing, NULL, 0);
-    system_create(&crew_capsule_system, "Crew", consume_oxygen, produce_nothing, 2, &manager->event_queue);
-
-    ResourceAmount consume_fuel_for_energy, produce_energy;
-    resource_amount_init(&consume_fuel_for_energy, fuel, 5);
-    resource_amount_init(&produce_energy, energy, 10);
-    system_create(&generator_system, "Generator", consume_fuel_for_energy, produce_energy, 20, &manager->event_queue);
-
-    system_array_add(&manager->system_array, propulsion_system);
-    system_array_add(&manager->system_array, life_support_system);
-    system_array_add(&manager->system_array, crew_capsule_system);
-    system_array_add(&manager->system_array, generator_system);
-}
\ No newline at end of file
+int replay_trace(Manager *manager, const Options *options) {
+    Event *events;
+    double *times;
+    long count;
+    TraceReplay replay;
+
+    int result = trace_load(options->replay, manager, &events, &times, &count);
+    if (result == -2) {
+        fprintf(stderr, "Trace %s was recorded with another scenario, give the same options as the traced run\n",
+                options->replay);
+        return 1;
+    } else if (result != 0) {
+        fprintf(stderr, "Cannot read trace %s\n", options->replay);
+        return 1;
+    }
+
+    trace_replay(manager, events, times, count, options->replay_rounds, &replay);
+    printf("Replayed %ld events %d times: best %.3f ms, mean %.3f ms (%.1f ns per event)\n", replay.events,
+           replay.rounds, replay.best_ms, replay.rounds > 0 ? replay.total_ms / replay.rounds : 0.0,
+           replay.events > 0 ? replay.best_ms * 1e6 / replay.events : 0.0);
+    printf("Decisions: %ld speed changes, digest %016llx", replay.changes, (unsigned long long)replay.digest);
+    if (replay.terminated_at >= 0) {
+        printf(", terminated by event %ld", replay.terminated_at);
+    }
+    printf("\n");
+
+    free(events);
+    free(times);
+    return 0;
+}
+
+/**
+ * Runs the simulation as continuous flows on the calling thread.
+ *
+ * Integrates the `FlowModel` in steps of `options->dt` and lets the manager handle the threshold events
+ * every `MANAGER_WAIT_TIME` simulated milliseconds, until the manager stops the simulation or `options->duration` is reached.
+ *
+ * @param[in,out] manager  Pointer to the `Manager` holding the loaded simulation.
+ * @param[in]     options  Pointer to the `Options` with the step size and duration.
+ */
+void run_continuous(Manager *manager, const Options *options) {
+    FlowModel model;
+    struct timespec start, end;
+    double next_manager_time = 0.0;
+    long steps = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    flow_model_init(&model, manager);
+
+    while (manager->simulation_running && model.time < options->duration) {
+        flow_model_step(&model, manager, options->dt);
+        steps++;
+        if (model.time >= next_manager_time) {
+            flow_model_sync(&model, manager);
+            manager->clock = model.time;
+            pause_gate_pass(&manager->gate);
+            manager_run(manager);
+            pause_gate_tick(&manager->gate);
+            flow_model_sync(&model, manager);
+            next_manager_time += MANAGER_WAIT_TIME;
+        }
+    }
+    flow_model_sync(&model, manager);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Continuous run: %d systems, %d resources, %.1f ms simulated in %ld steps, %.3f s wall time\n",
+           model.system_count, model.resource_count, model.time, steps, elapsed);
+
+    flow_model_clean(&model);
+}
+
+/**
+ * Parses the command line options.
+ *
+ * Supported options:
+ *   --seed N       Seed for the random streams (default `DEFAULT_SEED`).
+ *   --stochastic   Use randomly varying processing times for the sample systems.
+ *   --headless     Do not draw the simulation state in the terminal.
+ *   --scale N      Load N copies of the sample data.
+ *   --continuous   Integrate continuous flows instead of running one thread per system.
+ *   --dt MS        Step size of the continuous mode in milliseconds (default 1).
+ *   --duration MS  Maximum simulated time of the continuous mode in milliseconds (default one hour).
+ *   --backoff S    How systems retry failed steps: "fixed" (default), "adaptive", "park" (sleep until the resource
+ *                  reaches the level needed) or "queue" (park in order, refills are handed to the head of the queue).
+ *   --weight NAME:W  Serve systems named NAME before lighter ones on waiter queues (default weight 1, with --backoff queue);
+ *                  a waiter lets at most `SYSTEM_MAX_OVERTAKES` heavier systems pass, so lighter ones are not starved.
+ *   --metrics      Print per-system metrics when the simulation ends.
+ *   --predictive   Switch producers to FAST/SLOW ahead of forecast empty/full crossings.
+ *   --reserve      Reserve output space together with the input, so no cycle waits on a full output.
+ *   --scan         Find empty, low and full resources with a SIMD threshold scan each manager tick instead of events.
+ *   --group-control  Change the speed of all producers of a resource with one shared control word.
+ *   --crew N       Put N identical crew members in every capsule (default 1).
+ *   --aggregate    Merge identical systems into one system doing the work of all of them.
+ *   --record FILE  Record every change of the threaded run, with periodic snapshots, to a journal file.
+ *   --seek FILE MS Print the state MS milliseconds into a recorded run instead of running (same scenario options).
+ *   --workers N    Apply the manager's speed changes on N worker threads, partitioned by resource.
+ *   --profile FILE Sample every thread on SIGPROF and write folded stacks (for flame graphs) to FILE at exit.
+ *   --profile-hz N Samples per second of each thread's CPU time, up to `PROFILER_MAX_HZ` (default `PROFILER_DEFAULT_HZ`).
+ *   --trace FILE   Record every event the manager handles, in order, to a trace file.
+ *   --replay FILE  Replay a trace through the manager's decisions instead of running (same scenario options).
+ *   --replay-rounds N  Timed replays of the trace (default 10).
+ *   --policy FILE  Let a policy plugin (a shared library built against include/policy.h) make the manager's decisions.
+ *   --alloc-warmup MS  Report every allocation made later than MS milliseconds into the run, print the allocations
+ *                  per call site and exit with 1 if there were any late ones (needs an ALLOC_TRACKING build).
+ *   --control PATH Accept commands on a Unix domain socket: pause, resume, step N, query, checkpoint FILE.
+ *   --dashboard PORT  Serve a web dashboard on 127.0.0.1:PORT (0 for any free port), streaming changed values.
+ *
+ * @param[out] options  Pointer to the `Options` to fill.
+ * @param[in]  argc     Number of command line arguments.
+ * @param[in]  argv     Command line arguments.
+ */
+void parse_options(Options *options, int argc, char *argv[]) {
+    options->seed = DEFAULT_SEED;
+    options->stochastic = 0;
+    options->headless = 0;
+    options->scale = 1;
+    options->continuous = 0;
+    options->dt = 1.0;
+    options->duration = 3600.0 * 1000.0;
+    options->backoff = BACKOFF_FIXED;
+    options->metrics = 0;
+    options->predictive = 0;
+    options->reserve = 0;
+    options->scan = 0;
+    options->group_control = 0;
+    options->crew = 1;
+    options->aggregate = 0;
+    options->record = NULL;
+    options->seek = NULL;
+    options->seek_time = 0.0;
+    options->workers = 0;
+    options->profile = NULL;
+    options->profile_hz = PROFILER_DEFAULT_HZ;
+    options->alloc_warmup = -1.0;
+    options->trace = NULL;
+    options->replay = NULL;
+    options->replay_rounds = 10;
+    options->policy = NULL;
+    options->control = NULL;
+    options->dashboard = -1;
+    options->weight_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options->seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--stochastic") == 0) {
+            options->stochastic = 1;
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            options->headless = 1;
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            char *end;
+            long scale = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || scale < 1 || scale > INT_MAX) {
+                fprintf(stderr, "--scale needs a positive number of copies, got %s\n", argv[i]);
+                exit(1);
+            }
+            options->scale = (int)scale;
+        } else if (strcmp(argv[i], "--continuous") == 0) {
+            options->continuous = 1;
+        } else if (strcmp(argv[i], "--dt") == 0 && i + 1 < argc) {
+            char *end;
+            options->dt = strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || !(options->dt > 0.0)) {
+                fprintf(stderr, "--dt needs a positive number of milliseconds, got %s\n", argv[i]);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            char *end;
+            options->duration = strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || !(options->duration > 0.0)) {
+                fprintf(stderr, "--duration needs a positive number of milliseconds, got %s\n", argv[i]);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--backoff") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "fixed") == 0) {
+                options->backoff = BACKOFF_FIXED;
+            } else if (strcmp(argv[i], "adaptive") == 0) {
+                options->backoff = BACKOFF_ADAPTIVE;
+            } else if (strcmp(argv[i], "park") == 0) {
+                options->backoff = BACKOFF_PARK;
+            } else if (strcmp(argv[i], "queue") == 0) {
+                options->backoff = BACKOFF_QUEUE;
+            } else {
+                fprintf(stderr, "--backoff needs fixed, adaptive, park or queue, got %s\n", argv[i]);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--metrics") == 0) {
+            options->metrics = 1;
+        } else if (strcmp(argv[i], "--predictive") == 0) {
+            options->predictive = 1;
+        } else if (strcmp(argv[i], "--reserve") == 0) {
+            options->reserve = 1;
+        } else if (strcmp(argv[i], "--scan") == 0) {
+            options->scan = 1;
+        } else if (strcmp(argv[i], "--group-control") == 0) {
+            options->group_control = 1;
+        } else if (strcmp(argv[i], "--crew") == 0 && i + 1 < argc) {
+            options->crew = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--aggregate") == 0) {
+            options->aggregate = 1;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            options->record = argv[++i];
+        } else if (strcmp(argv[i], "--seek") == 0 && i + 2 < argc) {
+            options->seek = argv[++i];
+            options->seek_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            options->workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            options->profile = argv[++i];
+        } else if (strcmp(argv[i], "--profile-hz") == 0 && i + 1 < argc) {
+            options->profile_hz = atoi(argv[++i]);
+            if (options->profile_hz < 1 || options->profile_hz > PROFILER_MAX_HZ) {
+                fprintf(stderr, "--profile-hz needs a rate from 1 to %d, got %s\n", PROFILER_MAX_HZ, argv[i]);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options->trace = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            options->replay = argv[++i];
+        } else if (strcmp(argv[i], "--replay-rounds") == 0 && i + 1 < argc) {
+            options->replay_rounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+            options->policy = argv[++i];
+        } else if (strcmp(argv[i], "--control") == 0 && i + 1 < argc) {
+            options->control = argv[++i];
+        } else if (strcmp(argv[i], "--weight") == 0 && i + 1 < argc && options->weight_count < MAX_WEIGHT_OPTIONS) {
+            options->weights[options->weight_count++] = argv[++i];
+        } else if (strcmp(argv[i], "--dashboard") == 0 && i + 1 < argc) {
+            options->dashboard = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--alloc-warmup") == 0 && i + 1 < argc) {
+            options->alloc_warmup = atof(argv[++i]);
+            if (!alloc_tracking_enabled()) {
+                fprintf(stderr, "--alloc-warmup needs a build with ALLOC_TRACKING, see `make alloc-check`\n");
+            }
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            exit(1);
+        }
+    }
+    if (options->record && options->continuous) {
+        fprintf(stderr, "--record only records the threaded run, it cannot be combined with --continuous\n");
+        exit(1);
+    }
+}
@@ -4,10 +4,21 @@
 #include <unistd.h>
 #include <string.h>
 #include <time.h>
+#include <sched.h>
 
 // This function is only used by this file, so declared here and set to static to avoid having it linked by any other file
 
 static void display_simulation_state(Manager *manager);
+static int manager_set_speed(Manager *manager, Resource *resource, int status);
+static uint64_t manager_system_hash(const System *system);
+static int manager_systems_identical(const System *a, const System *b);
+static void manager_start_system_thread(Manager *manager, System *system);
+static void manager_count_waiting(Manager *manager);
+static int manager_event_is_global(const Event *event);
+static void manager_wait_workers(Manager *manager);
+static void *manager_worker_thread(void *arg);
+static void manager_terminate(Manager *manager);
+static void manager_apply_policy(Manager *manager);
 
 /**
  * Initializes the `Manager`.
@@ -19,6 +30,29 @@ static void display_simulation_state(Manager *manager);
  */
 void manager_init(Manager *manager) {
     manager->simulation_running = 1; 
+    manager->seed = DEFAULT_SEED;
+    manager->display_enabled = 1;
+    manager->predictive = 0;
+    manager->clock = 0.0;
+    manager->proactive_switches = 0;
+    manager->waiting_count = 0;
+    manager->waiting_peak = 0;
+    manager->journal = NULL;
+    manager->trace = NULL;
+    manager->policy = NULL;
+    manager->event_hook = NULL;
+    manager->event_hook_context = NULL;
+    manager->worker_count = 0;
+    manager->workers = NULL;
+    manager->scan = 0;
+    manager->group_control = 0;
+    memset(&manager->threshold_scan, 0, sizeof(ThresholdScan));
+    manager->parked_count = 0;
+    manager->system_threads = NULL;
+    manager->system_thread_started = NULL;
+    manager->system_thread_capacity = 0;
+    manager->threads_running = 0;
+    pause_gate_init(&manager->gate);
     system_array_init(&manager->system_array);
     resource_array_init(&manager->resource_array);
     event_queue_init(&manager->event_queue);
@@ -35,8 +69,338 @@ void manager_clean(Manager *manager) {
     system_array_clean(&manager->system_array);
     resource_array_clean(&manager->resource_array);
     event_queue_clean(&manager->event_queue);
+    if (manager->threshold_scan.amounts) {
+        threshold_scan_clean(&manager->threshold_scan);
+    }
+    free(manager->system_threads);
+    free(manager->system_thread_started);
+    pause_gate_clean(&manager->gate);
+}
+
+/**
+ * Merges identical systems into aggregated systems with a multiplicity.
+ *
+ * Systems with the same input, output, processing time and distribution become one system whose `multiplicity`
+ * is the number of systems merged; each of its cycles consumes and produces for all of them, so aggregate flows
+ * are kept while threads, cycles and lock operations drop by the multiplicity. The first system of each group is
+ * kept (with its name), the others are destroyed, and ids and producer lists are rebuilt.
+ * Must be called before the simulation starts; uses a hash table so large scenarios merge in linear time.
+ *
+ * @param[in,out] manager  Pointer to the `Manager` holding the loaded systems.
+ * @return                 Number of systems merged into another one.
+ */
+int manager_aggregate(Manager *manager) {
+    SystemArray *systems = &manager->system_array;
+    SystemArray merged;
+    int slot_count = 1;
+    int removed = 0;
+
+    while (slot_count < systems->size * 2) {
+        slot_count *= 2;
+    }
+    int *slots = (int *)malloc(sizeof(int) * slot_count);
+    for (int i = 0; i < slot_count; i++) {
+        slots[i] = -1;
+    }
+
+    for (int i = 0; i < manager->resource_array.size; i++) {
+        manager->resource_array.resources[i]->producer_count = 0;
+    }
+
+    system_array_init(&merged);
+    for (int i = 0; i < systems->size; i++) {
+        System *system = systems->systems[i];
+        int slot = (int)(manager_system_hash(system) & (uint64_t)(slot_count - 1));
+
+        while (slots[slot] >= 0 && !manager_systems_identical(merged.systems[slots[slot]], system)) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+
+        if (slots[slot] >= 0) {
+            merged.systems[slots[slot]]->multiplicity += system->multiplicity;
+            system_destroy(system);
+            removed++;
+        } else {
+            slots[slot] = merged.size;
+            system_array_add(&merged, system);
+        }
+    }
+
+    free(slots);
+    free(systems->systems);
+    *systems = merged;
+    return removed;
+}
+
+/**
+ * Hashes the fields which decide whether two systems can be merged.
+ *
+ * @param[in] system  Pointer to the `System`.
+ * @return            Hash of its input, output, processing time and distribution.
+ */
+static uint64_t manager_system_hash(const System *system) {
+    uint64_t fields[] = {(uintptr_t)system->consumed.resource, (uint64_t)system->consumed.amount,
+                         (uintptr_t)system->produced.resource, (uint64_t)system->produced.amount,
+                         (uint64_t)system->processing_time, (uint64_t)system->distribution};
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (unsigned i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        hash = (hash ^ fields[i]) * 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+static int manager_systems_identical(const System *a, const System *b) {
+    return a->consumed.resource == b->consumed.resource && a->consumed.amount == b->consumed.amount &&
+           a->produced.resource == b->produced.resource && a->produced.amount == b->produced.amount &&
+           a->processing_time == b->processing_time && a->distribution == b->distribution && a->spread == b->spread;
+}
+
+/**
+ * Parks every system which can never run, and wakes parked systems which now can.
+ *
+ * A system can run if it consumes nothing, if its input starts with enough for one cycle, or if the input is produced
+ * by a system which can run. This is computed as a least fixed point with a worklist, so dead chains and cycles of
+ * systems waiting on each other are all found in O(systems + resources).
+ * Parked systems get no thread and the `Stepper` skips them. A system which already has a thread is never parked.
+ * Systems woken while the threads are running get a thread at once.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ * @return                 Number of systems parked after the analysis.
+ */
+int manager_prune(Manager *manager) {
+    int system_count = manager->system_array.size;
+    int resource_count = manager->resource_array.size;
+    System **systems = manager->system_array.systems;
+    int *consumer_start = (int *)calloc(resource_count + 1, sizeof(int));
+    int *consumers = (int *)malloc(sizeof(int) * (system_count > 0 ? system_count : 1));
+    int *queue = (int *)malloc(sizeof(int) * (system_count > 0 ? system_count : 1));
+    char *runnable = (char *)calloc(system_count > 0 ? system_count : 1, 1);
+    char *fed = (char *)calloc(resource_count > 0 ? resource_count : 1, 1);
+    int head = 0, tail = 0;
+
+    // Consumers of each resource, grouped by resource id
+    for (int s = 0; s < system_count; s++) {
+        if (systems[s]->consumed.resource) {
+            consumer_start[systems[s]->consumed.resource->id]++;
+        }
+    }
+    for (int r = 1; r <= resource_count; r++) {
+        consumer_start[r] += consumer_start[r - 1];
+    }
+    for (int s = system_count - 1; s >= 0; s--) {
+        if (systems[s]->consumed.resource) {
+            consumers[--consumer_start[systems[s]->consumed.resource->id]] = s;
+        }
+    }
+
+    for (int s = 0; s < system_count; s++) {
+        Resource *input = systems[s]->consumed.resource;
+        if (!input || input->amount >= systems[s]->consumed.amount) {
+            runnable[s] = 1;
+            queue[tail++] = s;
+        }
+    }
+
+    while (head < tail) {
+        System *system = systems[queue[head++]];
+        Resource *output = system->produced.resource;
+
+        if (!output || system->produced.amount <= 0 || fed[output->id]) {
+            continue;
+        }
+        fed[output->id] = 1;
+        for (int i = consumer_start[output->id]; i < consumer_start[output->id + 1]; i++) {
+            if (!runnable[consumers[i]]) {
+                runnable[consumers[i]] = 1;
+                queue[tail++] = consumers[i];
+            }
+        }
+    }
+
+    manager->parked_count = 0;
+    for (int s = 0; s < system_count; s++) {
+        System *system = systems[s];
+        int has_thread = s < manager->system_thread_capacity && manager->system_thread_started[s];
+
+        if (runnable[s] && system->parked) {
+            system->parked = 0;
+            if (manager->threads_running && system->status != TERMINATE) {
+                manager_start_system_thread(manager, system);
+            }
+        } else if (!runnable[s] && !has_thread) {
+            system->parked = 1;
+        }
+        manager->parked_count += system->parked;
+    }
+
+    free(consumer_start);
+    free(consumers);
+    free(queue);
+    free(runnable);
+    free(fed);
+    return manager->parked_count;
+}
+
+/**
+ * Adds a `System` to a simulation which may already be running.
+ *
+ * If systems are parked the analysis is run again, so a new producer wakes the systems waiting on its output
+ * (and, transitively, the systems waiting on theirs). Must be called from the thread driving the manager.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ * @param[in]     system   Pointer to the `System` to add.
+ */
+void manager_add_system(Manager *manager, System *system) {
+    system_array_add(&manager->system_array, system);
+    rng_seed(&system->rng, manager->seed, (uint64_t)system->id);
+
+    if (manager->parked_count > 0) {
+        manager_prune(manager);
+    }
+    if (manager->threads_running && !system->parked) {
+        manager_start_system_thread(manager, system);
+    }
+}
+
+/**
+ * Starts one thread per system which is not parked.
+ * The event queue gets its nodes first, so the running systems' pushes do not allocate.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ */
+void manager_start_threads(Manager *manager) {
+    event_queue_reserve(&manager->event_queue, manager->system_array.size * EVENT_NODES_PER_SYSTEM);
+    manager->threads_running = 1;
+    for (int i = 0; i < manager->system_array.size; i++) {
+        if (!manager->system_array.systems[i]->parked) {
+            manager_start_system_thread(manager, manager->system_array.systems[i]);
+        }
+    }
+}
+
+/**
+ * Waits for every system thread to finish.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ */
+void manager_join_threads(Manager *manager) {
+    for (int i = 0; i < manager->system_thread_capacity; i++) {
+        if (manager->system_thread_started[i]) {
+            pthread_join(manager->system_threads[i], NULL);
+            manager->system_thread_started[i] = 0;
+        }
+    }
+    manager->threads_running = 0;
 }
 
+/**
+ * Starts the thread of one system, growing the thread arrays if necessary (doubling the size).
+ *
+ * Use of realloc is NOT permitted.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ * @param[in]     system   Pointer to the `System` to start.
+ */
+static void manager_start_system_thread(Manager *manager, System *system) {
+    if (system->id >= manager->system_thread_capacity) {
+        int capacity = (manager->system_thread_capacity > 0) ? manager->system_thread_capacity : 1;
+        while (capacity <= system->id) {
+            capacity *= 2;
+        }
+        pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * capacity);
+        int *started = (int *)calloc(capacity, sizeof(int));
+        for (int i = 0; i < manager->system_thread_capacity; i++) {
+            threads[i] = manager->system_threads[i];
+            started[i] = manager->system_thread_started[i];
+        }
+        free(manager->system_threads);
+        free(manager->system_thread_started);
+        manager->system_threads = threads;
+        manager->system_thread_started = started;
+        manager->system_thread_capacity = capacity;
+    }
+
+    if (!manager->system_thread_started[system->id]) {
+        system->gate = &manager->gate;
+        pthread_create(&manager->system_threads[system->id], NULL, system_thread, system);
+        manager->system_thread_started[system->id] = 1;
+    }
+}
+
+/**
+ * Seeds the random stream of every system in the simulation.
+ *
+ * Each system gets its own stream derived from `seed` and its id, so runs with the same seed
+ * draw the same processing times without sharing a generator between threads.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ * @param[in]     seed     Seed for the whole simulation.
+ */
+void manager_seed(Manager *manager, uint64_t seed) {
+    manager->seed = seed;
+    for (int i = 0; i < manager->system_array.size; i++) {
+        System *system = manager->system_array.systems[i];
+        rng_seed(&system->rng, seed, (uint64_t)system->id);
+    }
+}
+
+/**
+ * Prints the metrics of every system and their totals.
+ *
+ * Should be called once the system threads have stopped, the counters are read without synchronization.
+ *
+ * @param[in] manager  Pointer to the `Manager`.
+ */
+void manager_print_metrics(Manager *manager) {
+    SystemMetrics total = {0};
+
+    printf("%-16s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+           "System", "Cycles", "Failed", "Full", "Retries", "Spins", "Sleeps", "Events", "Parks", "Parked s");
+
+    for (int i = 0; i < manager->system_array.size; i++) {
+        System *system = manager->system_array.systems[i];
+        SystemMetrics *metrics = &system->metrics;
+
+        char label[32];
+        snprintf(label, sizeof(label), (system->multiplicity > 1) ? "%s x%d" : "%s", system->name, system->multiplicity);
+        printf("%-16s %10ld %10ld %10ld %10ld %10ld %10ld %10ld %10ld %10.2f\n", label, metrics->cycles, metrics->failed_cycles,
+               metrics->failed_stores, metrics->retries, metrics->spins, metrics->sleeps, metrics->events,
+               metrics->parks, metrics->parked_ms / 1000.0);
+
+        total.cycles += metrics->cycles;
+        total.failed_cycles += metrics->failed_cycles;
+        total.failed_stores += metrics->failed_stores;
+        total.retries += metrics->retries;
+        total.spins += metrics->spins;
+        total.sleeps += metrics->sleeps;
+        total.events += metrics->events;
+        total.parks += metrics->parks;
+        total.parked_ms += metrics->parked_ms;
+        total.handoffs += metrics->handoffs;
+        total.lost_races += metrics->lost_races;
+    }
+
+    printf("%-16s %10ld %10ld %10ld %10ld %10ld %10ld %10ld %10ld %10.2f\n", "Total", total.cycles, total.failed_cycles,
+           total.failed_stores, total.retries, total.spins, total.sleeps, total.events, total.parks, total.parked_ms / 1000.0);
+
+    if (total.parks > 0 && manager->clock > 0.0) {
+        int active = manager->system_array.size - manager->parked_count;
+        printf("Systems: %d active, parked on a resource %.1f%% of the time, at most %d at once\n", active,
+               100.0 * total.parked_ms / (manager->clock * (active > 0 ? active : 1)), manager->waiting_peak);
+        printf("Failed attempts per cycle: %.3f, %.3f of them right after waking; inputs handed over while queued: %ld\n",
+               total.cycles > 0 ? (double)total.failed_cycles / total.cycles : 0.0,
+               total.cycles > 0 ? (double)total.lost_races / total.cycles : 0.0, total.handoffs);
+    }
+    if (manager->parked_count > 0) {
+        printf("Systems parked at load: %d\n", manager->parked_count);
+    }
+
+    if (manager->predictive) {
+        printf("Proactive speed changes: %ld\n", manager->proactive_switches);
+    }
+}
 
 /**
  * Runs the manager loop.
@@ -48,47 +412,439 @@ void manager_clean(Manager *manager) {
  */
 void manager_run(Manager *manager) {
     Event event;
-    int event_found_flag = 0;
-    int no_oxygen_flag = 0, distance_reached_flag = 0, need_more_flag = 0, need_less_flag = 0;
-    int status = STANDARD;
 
-    display_simulation_state(manager);
+    manager_count_waiting(manager);
+    if (manager->journal && journal_now(manager->journal) - manager->journal->snapshot_time >= JOURNAL_SNAPSHOT_INTERVAL) {
+        journal_snapshot(manager->journal, manager);
+    }
+    if (manager->display_enabled) {
+        int role = profiler_set_role(PROFILE_DISPLAY);
+        display_simulation_state(manager);
+        profiler_set_role(role);
+    }
+
+    manager_forecast(manager);
+
+    if (manager->scan) {
+        manager_scan(manager);
+    }
+
+    while (event_queue_pop(&manager->event_queue, &event)) {
+        manager_dispatch_event(manager, &event);
+    }
+    if (manager->policy) {
+        manager_apply_policy(manager);
+    }
+    manager_wait_workers(manager);
+}
+
+/**
+ * Counts the systems parked on resource waiter lists and keeps the peak for the metrics.
+ *
+ * Counts are read without locking, like the display reads amounts.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ */
+static void manager_count_waiting(Manager *manager) {
+    int waiting = 0;
+
+    for (int i = 0; i < manager->resource_array.size; i++) {
+        waiting += __atomic_load_n(&manager->resource_array.resources[i]->waiter_count, __ATOMIC_RELAXED);
+    }
+    manager->waiting_count = waiting;
+    if (waiting > manager->waiting_peak) {
+        manager->waiting_peak = waiting;
+    }
+}
+
+/**
+ * Updates the flow forecast of every resource and, in predictive mode, acts on it.
+ *
+ * A resource forecast to run out within `FORECAST_HORIZON` has its producers switched to FAST, and one
+ * forecast to fill up within the horizon has them switched to SLOW, before any consumer fails or producer stalls.
+ * Once no crossing is forecast any more the producers the forecast switched go back to STANDARD, so a resource
+ * is not left overproducing (or starved) after the crossing it was switched for has passed.
+ * Uses `manager->clock`, which must be set by the caller of `manager_run`.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ */
+void manager_forecast(Manager *manager) {
+    for (int i = 0; i < manager->resource_array.size; i++) {
+        Resource *resource = manager->resource_array.resources[i];
+        resource_forecast_update(resource, manager->clock);
+
+        if (!manager->predictive || resource->producer_count == 0) {
+            continue;
+        }
+
+        int status;
+        if (resource_time_to_empty(resource) < FORECAST_HORIZON) {
+            status = FAST;
+        } else if (resource_time_to_full(resource) < FORECAST_HORIZON) {
+            status = SLOW;
+        } else if (resource->forecast_status != STANDARD) {
+            status = STANDARD;
+        } else {
+            continue;
+        }
+
+        manager->proactive_switches += manager_set_speed(manager, resource, status);
+        resource->forecast_status = status;
+    }
+}
+
+/**
+ * Changes the speed of every producer of a `Resource`.
+ *
+ * In group control mode this is a single write to the resource's control word, which the producers read each cycle;
+ * otherwise the status of each producer is written. Terminated producers are left alone either way.
+ *
+ * @param[in,out] manager   Pointer to the `Manager`.
+ * @param[in,out] resource  Pointer to the `Resource` whose producers change speed.
+ * @param[in]     status    SLOW, STANDARD or FAST.
+ * @return                  Number of writes which changed something.
+ */
+static int manager_set_speed(Manager *manager, Resource *resource, int status) {
+    int changes = 0;
+
+    if (manager->group_control) {
+        if (resource->control->status != status) {
+            __atomic_store_n(&resource->control->status, status, __ATOMIC_RELAXED);
+            changes++;
+            // The journal holds system statuses, so a group change is recorded as the new speed of each producer
+            for (int i = 0; manager->journal && i < resource->producer_count; i++) {
+                journal_record(manager->journal, JOURNAL_STATUS, resource->producers[i]->id, system_speed(resource->producers[i]));
+            }
+        }
+        return changes;
+    }
+
+    for (int i = 0; i < resource->producer_count; i++) {
+        System *producer = resource->producers[i];
+        if (producer->status != status && producer->status != TERMINATE) {
+            producer->status = status;
+            changes++;
+            if (manager->journal) {
+                journal_record(manager->journal, JOURNAL_STATUS, producer->id, status);
+            }
+        }
+    }
+    return changes;
+}
+
+/**
+ * Finds the resources which crossed a threshold since the last tick with a `ThresholdScan` and acts on them.
+ *
+ * The cost is one gather and one compare per resource whatever the failure rate; only newly set bits lead to work.
+ * Each crossing is handled exactly like the event a system would have sent for it (empty, low or at capacity),
+ * so termination and speed changes follow the same rules as in event mode.
+ * The scan is rebuilt, allocating, only when resources or systems were added since the last tick.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ */
+void manager_scan(Manager *manager) {
+    ThresholdScan *scan = &manager->threshold_scan;
+    Event event;
+
+    if (!scan->amounts || scan->count != manager->resource_array.size || scan->system_count != manager->system_array.size) {
+        if (scan->amounts) {
+            threshold_scan_clean(scan);
+        }
+        threshold_scan_init(scan, manager);
+    }
+
+    threshold_scan_gather(scan, manager);
+    threshold_scan_compare(scan);
+
+    for (int w = 0; w < scan->words && manager->simulation_running; w++) {
+        uint64_t empty = scan->masks[SCAN_EMPTY][w] & ~scan->previous[SCAN_EMPTY][w];
+        uint64_t low = scan->masks[SCAN_LOW][w] & ~scan->previous[SCAN_LOW][w];
+        uint64_t full = scan->masks[SCAN_FULL][w] & ~scan->previous[SCAN_FULL][w];
+        uint64_t crossed = empty | low | full;
+
+        while (crossed) {
+            int bit = __builtin_ctzll(crossed);
+            int r = w * SCAN_WORD_BITS + bit;
+            uint64_t flag = (uint64_t)1 << bit;
+            crossed &= crossed - 1;
+
+            if (empty & flag) {
+                event_init(&event, scan->consumers[r], manager->resource_array.resources[r], STATUS_EMPTY, PRIORITY_HIGH, scan->amounts[r]);
+            } else if (low & flag) {
+                event_init(&event, scan->consumers[r], manager->resource_array.resources[r], STATUS_LOW, PRIORITY_HIGH, scan->amounts[r]);
+            } else {
+                event_init(&event, scan->producers[r], manager->resource_array.resources[r], STATUS_CAPACITY, PRIORITY_LOW, scan->amounts[r]);
+            }
+            manager_dispatch_event(manager, &event);
+        }
+    }
+}
+
+/**
+ * Starts `count` workers which apply the speed changes of `manager_handle_event` in parallel.
+ *
+ * Events are partitioned by resource id, and a resource's producers are only changed for events about that resource,
+ * so workers never write the same system. Termination stays on the manager thread (see `manager_dispatch_event`).
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ * @param[in]     count    Number of workers, zero to keep handling every event on the manager thread.
+ */
+void manager_start_workers(Manager *manager, int count) {
+    if (count <= 0) {
+        return;
+    }
+
+    manager->workers = (ManagerWorker *)aligned_alloc(CACHE_LINE_SIZE, sizeof(ManagerWorker) * count);
+    for (int i = 0; i < count; i++) {
+        ManagerWorker *worker = &manager->workers[i];
+        worker->manager = manager;
+        worker->stopping = 0;
+        worker->pushed = 0;
+        worker->handled = 0;
+        sem_init(&worker->wake, 0, 0);
+        pthread_create(&worker->thread, NULL, manager_worker_thread, worker);
+    }
+    manager->worker_count = count;
+}
+
+/**
+ * Stops the workers once they have applied every pending event, and frees them.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ */
+void manager_stop_workers(Manager *manager) {
+    for (int i = 0; i < manager->worker_count; i++) {
+        ManagerWorker *worker = &manager->workers[i];
+        __atomic_store_n(&worker->stopping, 1, __ATOMIC_RELEASE);
+        sem_post(&worker->wake);
+        pthread_join(worker->thread, NULL);
+        sem_destroy(&worker->wake);
+    }
+    free(manager->workers);
+    manager->workers = NULL;
+    manager->worker_count = 0;
+}
+
+/**
+ * Hands an event to the worker owning its resource, or handles it on the manager thread.
+ *
+ * Events which terminate the simulation are handled here, after every worker has applied its pending events,
+ * so no worker can switch a terminated system back to FAST or SLOW. Without workers every event is handled here.
+ * When the worker's ring is full the manager waits for it, so events are never dropped or reordered.
+ * Every event is first appended to the manager's trace when one is being recorded, and passed to the event hook
+ * when one is set (benchmarks count and time the events handled with it).
+ * With a policy plugin the event only joins the batch the plugin decides on at the end of `manager_run`.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ * @param[in]     event    Pointer to the `Event` to handle.
+ */
+void manager_dispatch_event(Manager *manager, const Event *event) {
+    if (manager->trace) {
+        trace_record(manager->trace, manager->clock, event);
+    }
+    if (manager->event_hook) {
+        manager->event_hook(manager->event_hook_context, event);
+    }
+    if (manager->policy) {
+        policy_add_event(manager->policy, event);
+        return;
+    }
+    if (manager->worker_count == 0 || !manager->simulation_running || manager_event_is_global(event)) {
+        manager_wait_workers(manager);
+        manager_handle_event(manager, event);
+        return;
+    }
+
+    ManagerWorker *worker = &manager->workers[event->resource->id % manager->worker_count];
+    while (worker->pushed - __atomic_load_n(&worker->handled, __ATOMIC_ACQUIRE) == WORKER_RING_SIZE) {
+        sched_yield();
+    }
+    worker->ring[worker->pushed & (WORKER_RING_SIZE - 1)] = *event;
+    __atomic_store_n(&worker->pushed, worker->pushed + 1, __ATOMIC_RELEASE);
+    sem_post(&worker->wake);
+}
 
-    event_found_flag = event_queue_pop(&manager->event_queue, &event);
+/**
+ * Waits until every worker has applied all the events handed to it.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ */
+static void manager_wait_workers(Manager *manager) {
+    for (int i = 0; i < manager->worker_count; i++) {
+        ManagerWorker *worker = &manager->workers[i];
+        while (__atomic_load_n(&worker->handled, __ATOMIC_ACQUIRE) != worker->pushed) {
+            sched_yield();
+        }
+    }
+}
 
-    while (event_found_flag) {
+/**
+ * Main loop of a manager worker: applies the events in its ring until it is stopped.
+ *
+ * @param[in,out] arg  Pointer to the `ManagerWorker`.
+ * @return             NULL.
+ */
+static void *manager_worker_thread(void *arg) {
+    ManagerWorker *worker = (ManagerWorker *)arg;
+
+    profiler_thread_start(PROFILE_WORKER);
+    for (;;) {
+        while (sem_wait(&worker->wake) != 0) {
+            // Interrupted by a signal, keep waiting
+        }
+        unsigned long pushed = __atomic_load_n(&worker->pushed, __ATOMIC_ACQUIRE);
+        while (worker->handled != pushed) {
+            manager_handle_event(worker->manager, &worker->ring[worker->handled & (WORKER_RING_SIZE - 1)]);
+            __atomic_store_n(&worker->handled, worker->handled + 1, __ATOMIC_RELEASE);
+        }
+        if (__atomic_load_n(&worker->stopping, __ATOMIC_ACQUIRE)) {
+            profiler_thread_stop();
+            return NULL;
+        }
+    }
+}
+
+/**
+ * Checks whether an event is subject to a global rule, which ends the simulation for every system.
+ *
+ * @param[in] event  Pointer to the `Event`.
+ * @return           Non-zero if Oxygen ran out or the destination Distance was reached.
+ */
+static int manager_event_is_global(const Event *event) {
+    return (event->status == STATUS_EMPTY && strcmp(event->resource->name, "Oxygen") == 0) ||
+           (event->status == STATUS_CAPACITY && strcmp(event->resource->name, "Distance") == 0);
+}
+
+/**
+ * Handles a single event popped from the queue.
+ *
+ * Terminates the simulation when Oxygen runs out or the destination is reached, otherwise
+ * speeds up the producers of a resource that is running low and slows down those of a resource at capacity.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ * @param[in]     event    Pointer to the `Event` to handle.
+ */
+void manager_handle_event(Manager *manager, const Event *event) {
+    int no_oxygen_flag = 0, distance_reached_flag = 0, need_more_flag = 0, need_less_flag = 0;
+    int status = STANDARD;
+
+    if (manager->display_enabled) {
         printf("Event: [%s] Resource [%s : %d] Status [%d]\n",
-               event.system->name, event.resource->name, event.amount, event.status);
+               event->system->name, event->resource->name, event->amount, event->status);
+    }
+
+    no_oxygen_flag = manager_event_is_global(event) && event->status == STATUS_EMPTY;
+    distance_reached_flag = manager_event_is_global(event) && event->status == STATUS_CAPACITY;
+    need_more_flag = (event->status == STATUS_LOW || event->status == STATUS_EMPTY || event->status == STATUS_INSUFFICIENT);
+    need_less_flag = (event->status == STATUS_CAPACITY);
 
-        no_oxygen_flag = (event.status == STATUS_EMPTY && strcmp(event.resource->name, "Oxygen") == 0);
-        distance_reached_flag = (event.status == STATUS_CAPACITY && strcmp(event.resource->name, "Distance") == 0);
-        need_more_flag = (event.status == STATUS_LOW || event.status == STATUS_EMPTY || event.status == STATUS_INSUFFICIENT);
-        need_less_flag = (event.status == STATUS_CAPACITY);
+    if (!manager->simulation_running) {
+        return;  // Already terminating, every system has been told and must not be switched back to FAST/SLOW
+    }
 
-        if (no_oxygen_flag) {
+    if (no_oxygen_flag) {
+        if (manager->display_enabled) {
             printf("Oxygen depleted. Terminating all systems.\n");
-            status = TERMINATE;
-            manager->simulation_running = 0;
-        } else if (distance_reached_flag) {
+        }
+        status = TERMINATE;
+        manager->simulation_running = 0;
+    } else if (distance_reached_flag) {
+        if (manager->display_enabled) {
             printf("Destination reached. Terminating all systems.\n");
-            status = TERMINATE;
-            manager->simulation_running = 0;
-        } else if (need_more_flag) {
-            status = FAST;
-        } else if (need_less_flag) {
-            status = SLOW;
         }
+        status = TERMINATE;
+        manager->simulation_running = 0;
+    } else if (need_more_flag) {
+        status = FAST;
+    } else if (need_less_flag) {
+        status = SLOW;
+    }
+
+    if (status == TERMINATE) {
+        manager_terminate(manager);
+    } else if (need_more_flag || need_less_flag) {
+        manager_set_speed(manager, event->resource, status);
+    }
+}
 
-        if (no_oxygen_flag || distance_reached_flag || need_more_flag || need_less_flag) {
-            for (int i = 0; i < manager->system_array.size; i++) {
-                System *current_system = manager->system_array.systems[i];
-                if (status == TERMINATE || current_system->produced.resource == event.resource) {
-                    current_system->status = status;
+/**
+ * Handles a batch of events the way `manager_run` would: through the policy plugin as one batch if one is loaded,
+ * otherwise one by one with `manager_handle_event`. Used to replay traces on the calling thread.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ * @param[in]     events   Events to handle, in order.
+ * @param[in]     count    Number of events.
+ */
+void manager_handle_events(Manager *manager, const Event *events, int count) {
+    if (!manager->policy) {
+        for (int i = 0; i < count; i++) {
+            manager_handle_event(manager, &events[i]);
+        }
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        policy_add_event(manager->policy, &events[i]);
+    }
+    manager_apply_policy(manager);
+}
+
+/**
+ * Terminates every system and wakes the parked ones so they see it.
+ *
+ * @param[in,out] manager  Pointer to the `Manager`.
+ */
+static void manager_terminate(Manager *manager) {
+    manager->simulation_running = 0;
+    for (int i = 0; i < manager->system_array.size; i++) {
+        manager->system_array.systems[i]->status = TERMINATE;
+        if (manager->journal) {
+            journal_record(manager->journal, JOURNAL_STATUS, i, TERMINATE);
+        }
+    }
+    // Parked systems only run again when woken, and must see TERMINATE to exit
+    for (int i = 0; i < manager->resource_array.size; i++) {
+        resource_wake_all(manager->resource_array.resources[i]);
+    }
+}
+
+/**
+ * Asks the policy plugin to decide on the batch of events collected this tick and applies its decisions
+ * on the manager thread, in the order given.
+ *
+ * Decisions follow the rules of the built-in policy: nothing is changed once the simulation is terminating,
+ * and a terminated system is never given a speed again. Decisions naming an unknown kind, id or speed are
+ * counted as rejected and skipped.
+ *
+ * @param[in,out] manager  Pointer to the `Manager` with a loaded `policy`.
+ */
+static void manager_apply_policy(Manager *manager) {
+    PolicyPlugin *plugin = manager->policy;
+    int count = policy_decide(plugin, manager);
+
+    for (int i = 0; i < count && manager->simulation_running; i++) {
+        PolicyDecision *decision = &plugin->decisions[i];
+        int speed_valid = decision->status >= DISABLED && decision->status <= FAST;
+
+        if (decision->kind == POLICY_STOP) {
+            manager_terminate(manager);
+        } else if (decision->kind == POLICY_SET_PRODUCERS && speed_valid && decision->id >= 0 &&
+                   decision->id < manager->resource_array.size) {
+            manager_set_speed(manager, manager->resource_array.resources[decision->id], decision->status);
+        } else if (decision->kind == POLICY_SET_SYSTEM && speed_valid && decision->id >= 0 &&
+                   decision->id < manager->system_array.size) {
+            System *system = manager->system_array.systems[decision->id];
+            if (system->status != TERMINATE && system->status != decision->status) {
+                system->status = decision->status;
+                if (manager->journal) {
+                    journal_record(manager->journal, JOURNAL_STATUS, system->id, decision->status);
                 }
             }
+        } else {
+            plugin->rejected++;
+            continue;
         }
-
-        event_found_flag = event_queue_pop(&manager->event_queue, &event);
+        plugin->applied++;
     }
 }
 
@@ -120,6 +876,8 @@ static void display_simulation_state(Manager *manager) {
         printf(ANSI_LN_CLR "%s: %d / %d\n", resource->name, resource->amount, resource->max_capacity);
     }
 
+    printf(ANSI_LN_CLR "\nSystems: %d active, %d parked\n", manager->system_array.size - manager->parked_count - manager->waiting_count,
+           manager->parked_count + manager->waiting_count);
     printf(ANSI_LN_CLR "\nSystem Statuses:\n");
     printf(ANSI_LN_CLR "----------------\n");
 
@@ -127,7 +885,7 @@ static void display_simulation_state(Manager *manager) {
         System *system = manager->system_array.systems[i];
         const char *status_str = "UNKNOWN";
 
-        switch (system->status) {
+        switch (system_speed(system)) {
             case TERMINATE: status_str = "TERMINATE"; break;
             case DISABLED: status_str = "DISABLED"; break;
             case SLOW: status_str = "SLOW"; break;
@@ -135,7 +893,11 @@ static void display_simulation_state(Manager *manager) {
             case FAST: status_str = "FAST"; break;
         }
 
-        printf(ANSI_LN_CLR "%s: %s\n", system->name, status_str);
+        if (system->multiplicity > 1) {
+            printf(ANSI_LN_CLR "%s x%d: %s\n", system->name, system->multiplicity, status_str);
+        } else {
+            printf(ANSI_LN_CLR "%s: %s\n", system->name, status_str);
+        }
     }
 
     fflush(stdout);
@@ -143,9 +905,24 @@ static void display_simulation_state(Manager *manager) {
 
 void *manager_thread(void *arg) {
     Manager *manager = (Manager *)arg;
+    struct timespec start, now;
+    double paused_ms = 0.0;
+
+    profiler_thread_start(PROFILE_MANAGER);
+    clock_gettime(CLOCK_MONOTONIC, &start);
     while (manager->simulation_running) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_nsec - start.tv_nsec) / 1e6;
+        if (pause_gate_pass(&manager->gate)) {
+            // The clock stands still while paused
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            paused_ms += (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_nsec - start.tv_nsec) / 1e6 - elapsed;
+        }
+        manager->clock = elapsed - paused_ms;
         manager_run(manager);
+        pause_gate_tick(&manager->gate);
         usleep(MANAGER_WAIT_TIME * 1000);  
     }
+    profiler_thread_stop();
     return NULL;
 }
\ No newline at end of file
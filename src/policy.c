@@ -0,0 +1,170 @@
+#include "defs.h"
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Plugins see only include/policy.h, whose values must stay equal to the simulator's
+_Static_assert(POLICY_TERMINATE == TERMINATE && POLICY_DISABLED == DISABLED && POLICY_SLOW == SLOW &&
+               POLICY_STANDARD == STANDARD && POLICY_FAST == FAST, "policy speeds differ from system statuses");
+_Static_assert(POLICY_STATUS_EMPTY == STATUS_EMPTY && POLICY_STATUS_LOW == STATUS_LOW &&
+               POLICY_STATUS_INSUFFICIENT == STATUS_INSUFFICIENT && POLICY_STATUS_CAPACITY == STATUS_CAPACITY,
+               "policy event statuses differ from system event statuses");
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static void policy_refresh(PolicyPlugin *plugin, Manager *manager);
+
+/**
+ * Loads a policy plugin and creates its context.
+ *
+ * @param[out] plugin   Pointer to the `PolicyPlugin` to fill.
+ * @param[in]  path     Shared library exporting `POLICY_ENTRY_SYMBOL` (a path, or a name searched by dlopen).
+ * @param[in]  manager  Pointer to the `Manager` whose simulation the policy will control.
+ * @param[out] error    Set to a description of the failure when loading fails.
+ * @return              0 on success, -1 on failure.
+ */
+int policy_load(PolicyPlugin *plugin, const char *path, Manager *manager, const char **error) {
+    memset(plugin, 0, sizeof(PolicyPlugin));
+
+    plugin->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!plugin->handle) {
+        *error = dlerror();
+        return -1;
+    }
+
+    PolicyEntry entry;
+    *(void **)&entry = dlsym(plugin->handle, POLICY_ENTRY_SYMBOL);
+    plugin->policy = entry ? entry() : NULL;
+    if (!plugin->policy || plugin->policy->api_version != POLICY_API_VERSION || !plugin->policy->decide) {
+        *error = entry ? "the plugin was built for another policy interface" : "the plugin exports no " POLICY_ENTRY_SYMBOL;
+        dlclose(plugin->handle);
+        plugin->handle = NULL;
+        return -1;
+    }
+
+    plugin->event_capacity = POLICY_INITIAL_EVENTS;
+    plugin->events = (PolicyEvent *)malloc(sizeof(PolicyEvent) * plugin->event_capacity);
+    plugin->decisions = (PolicyDecision *)malloc(sizeof(PolicyDecision) * plugin->event_capacity * POLICY_DECISIONS_PER_EVENT);
+    policy_refresh(plugin, manager);
+    plugin->context = plugin->policy->create ? plugin->policy->create(&plugin->state) : NULL;
+    return 0;
+}
+
+/**
+ * Destroys the policy's context, unloads the plugin and frees its buffers.
+ *
+ * @param[in,out] plugin  Pointer to the loaded `PolicyPlugin`.
+ */
+void policy_unload(PolicyPlugin *plugin) {
+    if (plugin->policy->destroy) {
+        plugin->policy->destroy(plugin->context);
+    }
+    dlclose(plugin->handle);
+    free(plugin->resources);
+    free(plugin->systems);
+    free(plugin->events);
+    free(plugin->decisions);
+    memset(plugin, 0, sizeof(PolicyPlugin));
+}
+
+/**
+ * Adds an event to the batch handed to the policy at the next decision,
+ * growing the batch if necessary (doubling the size).
+ *
+ * Use of realloc is NOT permitted.
+ *
+ * @param[in,out] plugin  Pointer to the loaded `PolicyPlugin`.
+ * @param[in]     event   Pointer to the `Event`.
+ */
+void policy_add_event(PolicyPlugin *plugin, const Event *event) {
+    if (plugin->event_count == plugin->event_capacity) {
+        plugin->event_capacity *= 2;
+        PolicyEvent *new_events = (PolicyEvent *)malloc(sizeof(PolicyEvent) * plugin->event_capacity);
+        for (int i = 0; i < plugin->event_count; i++) {
+            new_events[i] = plugin->events[i];
+        }
+        free(plugin->events);
+        plugin->events = new_events;
+        free(plugin->decisions);
+        plugin->decisions = (PolicyDecision *)malloc(sizeof(PolicyDecision) * plugin->event_capacity * POLICY_DECISIONS_PER_EVENT);
+    }
+
+    PolicyEvent *entry = &plugin->events[plugin->event_count++];
+    entry->system = event->system ? event->system->id : -1;
+    entry->resource = event->resource ? event->resource->id : -1;
+    entry->status = event->status;
+    entry->priority = event->priority;
+    entry->amount = event->amount;
+}
+
+/**
+ * Hands the batch of events and a fresh snapshot to the policy and empties the batch.
+ *
+ * The policy is asked every manager tick, with or without events, so it can also act on the state alone.
+ *
+ * @param[in,out] plugin   Pointer to the loaded `PolicyPlugin`.
+ * @param[in]     manager  Pointer to the `Manager`.
+ * @return                 Number of decisions written to `plugin->decisions`.
+ */
+int policy_decide(PolicyPlugin *plugin, Manager *manager) {
+    int capacity = plugin->event_capacity * POLICY_DECISIONS_PER_EVENT;
+
+    policy_refresh(plugin, manager);
+    int count = plugin->policy->decide(plugin->context, &plugin->state, plugin->events, plugin->event_count,
+                                       plugin->decisions, capacity);
+    plugin->event_count = 0;
+    plugin->batches++;
+    if (count < 0) {
+        count = 0;
+    } else if (count > capacity) {
+        count = capacity;
+    }
+    return count;
+}
+
+/**
+ * Copies the current amounts and speeds into the snapshot, growing its storage when resources or systems
+ * were added since the last decision. Amounts are read without locking, like the display reads them.
+ *
+ * @param[in,out] plugin   Pointer to the `PolicyPlugin`.
+ * @param[in]     manager  Pointer to the `Manager`.
+ */
+static void policy_refresh(PolicyPlugin *plugin, Manager *manager) {
+    int resource_count = manager->resource_array.size;
+    int system_count = manager->system_array.size;
+
+    if (resource_count > plugin->resource_capacity) {
+        free(plugin->resources);
+        plugin->resource_capacity = resource_count;
+        plugin->resources = (PolicyResource *)malloc(sizeof(PolicyResource) * resource_count);
+    }
+    if (system_count > plugin->system_capacity) {
+        free(plugin->systems);
+        plugin->system_capacity = system_count;
+        plugin->systems = (PolicySystem *)malloc(sizeof(PolicySystem) * system_count);
+    }
+
+    for (int i = 0; i < resource_count; i++) {
+        Resource *resource = manager->resource_array.resources[i];
+        PolicyResource *entry = &plugin->resources[i];
+        entry->name = resource->name;
+        entry->amount = __atomic_load_n(&resource->amount, __ATOMIC_RELAXED);
+        entry->max_capacity = resource->max_capacity;
+        entry->producer_count = resource->producer_count;
+    }
+    for (int i = 0; i < system_count; i++) {
+        System *system = manager->system_array.systems[i];
+        PolicySystem *entry = &plugin->systems[i];
+        entry->name = system->name;
+        entry->speed = system_speed(system);
+        entry->consumed = system->consumed.resource ? system->consumed.resource->id : -1;
+        entry->produced = system->produced.resource ? system->produced.resource->id : -1;
+    }
+
+    plugin->state.clock = manager->clock;
+    plugin->state.resource_count = resource_count;
+    plugin->state.resources = plugin->resources;
+    plugin->state.system_count = system_count;
+    plugin->state.systems = plugin->systems;
+}
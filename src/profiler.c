@@ -0,0 +1,268 @@
+#include "defs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <execinfo.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+#define PROFILER_SKIP_FRAMES 2   // The handler and the signal trampoline, which start every captured stack
+
+// The signal handler cannot be given an argument, so the running profiler and each thread's state are kept here
+static Profiler *active_profiler = NULL;
+static __thread int thread_role = PROFILE_SYSTEM;
+static __thread int thread_timer_armed = 0;
+static __thread timer_t thread_timer;
+static const char *profile_role_names[PROFILE_ROLES] = {"system", "manager", "display", "worker"};
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static void profiler_handle_signal(int signal_number);
+static char *profiler_fold_sample(const ProfileSample *sample);
+static int profiler_compare_strings(const void *a, const void *b);
+
+/**
+ * Starts sampling every thread which calls `profiler_thread_start` from now on.
+ *
+ * Allocates all sample storage up front and installs the SIGPROF handler.
+ * Only one profiler can run at a time.
+ *
+ * @param[out] profiler  Pointer to the `Profiler` to start.
+ * @param[in]  hz        Samples per second of CPU time of each thread, from 1 to `PROFILER_MAX_HZ`.
+ * @return               0 on success, -1 if `hz` is out of range or the handler could not be installed.
+ */
+int profiler_start(Profiler *profiler, int hz) {
+    struct sigaction action;
+    void *warm_up[1];
+
+    if (hz < 1 || hz > PROFILER_MAX_HZ) {
+        profiler->samples = NULL;
+        return -1;
+    }
+    profiler->hz = hz;
+    profiler->capacity = PROFILER_MAX_SAMPLES;
+    profiler->count = 0;
+    profiler->unsampled = 0;
+    profiler->samples = (ProfileSample *)malloc(sizeof(ProfileSample) * profiler->capacity);
+
+    // The first call to backtrace loads the unwinder, which allocates: do it here and not in the handler
+    backtrace(warm_up, 1);
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = profiler_handle_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, NULL) != 0) {
+        free(profiler->samples);
+        profiler->samples = NULL;
+        return -1;
+    }
+
+    __atomic_store_n(&active_profiler, profiler, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * Stops sampling. Threads should have called `profiler_thread_stop` already; late signals are ignored.
+ *
+ * @param[in,out] profiler  Pointer to the `Profiler`.
+ */
+void profiler_stop(Profiler *profiler) {
+    (void)profiler;
+    signal(SIGPROF, SIG_IGN);
+    __atomic_store_n(&active_profiler, NULL, __ATOMIC_RELEASE);
+}
+
+/**
+ * Starts sampling the calling thread, if a profiler is running.
+ *
+ * The timer counts the thread's own CPU time, so threads sleeping in `usleep` or waiting on a lock cost
+ * nothing and are not sampled.
+ *
+ * @param[in] role  PROFILE_ role the thread's samples are attributed to.
+ */
+void profiler_thread_start(int role) {
+    Profiler *profiler = __atomic_load_n(&active_profiler, __ATOMIC_ACQUIRE);
+    struct sigevent event;
+    struct itimerspec interval;
+
+    thread_role = role;
+    if (!profiler || thread_timer_armed) {
+        return;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = (pid_t)syscall(SYS_gettid);
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &thread_timer) != 0) {
+        __atomic_add_fetch(&profiler->unsampled, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    long period = 1000000000L / profiler->hz;   // At 1 Hz a whole second, which tv_nsec alone cannot hold
+    interval.it_interval.tv_sec = period / 1000000000L;
+    interval.it_interval.tv_nsec = period % 1000000000L;
+    interval.it_value = interval.it_interval;
+    if (timer_settime(thread_timer, 0, &interval, NULL) != 0) {
+        timer_delete(thread_timer);
+        __atomic_add_fetch(&profiler->unsampled, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    thread_timer_armed = 1;
+}
+
+/**
+ * Stops sampling the calling thread. Must be called before a registered thread exits.
+ */
+void profiler_thread_stop(void) {
+    if (thread_timer_armed) {
+        timer_delete(thread_timer);
+        thread_timer_armed = 0;
+    }
+}
+
+/**
+ * Changes the role the calling thread's samples are attributed to, e.g. while the manager draws the display.
+ *
+ * @param[in] role  New PROFILE_ role.
+ * @return          The previous role, to restore afterwards.
+ */
+int profiler_set_role(int role) {
+    int previous = thread_role;
+    thread_role = role;
+    return previous;
+}
+
+/**
+ * SIGPROF handler: claims a slot with an atomic increment and copies the interrupted stack into it.
+ *
+ * @param[in] signal_number  Unused.
+ */
+static void profiler_handle_signal(int signal_number) {
+    Profiler *profiler = __atomic_load_n(&active_profiler, __ATOMIC_ACQUIRE);
+    void *frames[PROFILER_MAX_DEPTH + PROFILER_SKIP_FRAMES];
+    (void)signal_number;
+
+    if (!profiler) {
+        return;
+    }
+
+    int slot = __atomic_fetch_add(&profiler->count, 1, __ATOMIC_RELAXED);
+    if (slot >= profiler->capacity) {
+        return;
+    }
+
+    int depth = backtrace(frames, PROFILER_MAX_DEPTH + PROFILER_SKIP_FRAMES) - PROFILER_SKIP_FRAMES;
+    ProfileSample *sample = &profiler->samples[slot];
+    sample->role = thread_role;
+    sample->depth = (depth > 0) ? depth : 0;
+    for (int i = 0; i < sample->depth; i++) {
+        sample->frames[i] = frames[i + PROFILER_SKIP_FRAMES];
+    }
+}
+
+/**
+ * Writes the samples as folded stacks (one "role;outer;...;inner count" line per distinct stack), the input
+ * format of flamegraph.pl and speedscope, then frees the samples and prints a summary per role.
+ *
+ * Functions are named from the dynamic symbol table, so the program is linked with -rdynamic;
+ * static functions appear as "module+offset", which addr2line resolves.
+ *
+ * @param[in,out] profiler  Pointer to the stopped `Profiler`.
+ * @param[in]     path      File to write.
+ * @return                  0 on success, -1 if the file could not be created.
+ */
+int profiler_write_folded(Profiler *profiler, const char *path) {
+    int kept = (profiler->count < profiler->capacity) ? profiler->count : profiler->capacity;
+    long role_samples[PROFILE_ROLES] = {0};
+    char **lines = (char **)malloc(sizeof(char *) * (kept > 0 ? kept : 1));
+    FILE *file = fopen(path, "w");
+
+    for (int i = 0; i < kept; i++) {
+        lines[i] = profiler_fold_sample(&profiler->samples[i]);
+        role_samples[profiler->samples[i].role]++;
+    }
+    qsort(lines, kept, sizeof(char *), profiler_compare_strings);
+
+    for (int i = 0; i < kept;) {
+        int same = 1;
+        while (i + same < kept && strcmp(lines[i], lines[i + same]) == 0) {
+            same++;
+        }
+        if (file) {
+            fprintf(file, "%s %d\n", lines[i], same);
+        }
+        i += same;
+    }
+    for (int i = 0; i < kept; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    free(profiler->samples);
+    profiler->samples = NULL;
+
+    printf("Profile: %d samples at %d Hz (", kept, profiler->hz);
+    for (int r = 0; r < PROFILE_ROLES; r++) {
+        printf("%s%s %.1f%%", (r > 0) ? ", " : "", profile_role_names[r], kept > 0 ? 100.0 * role_samples[r] / kept : 0.0);
+    }
+    printf("), %d dropped, written to %s\n", profiler->count - kept, path);
+    if (profiler->unsampled > 0) {
+        printf("Profile: %d threads could not be sampled, their timers failed\n", profiler->unsampled);
+    }
+
+    if (!file) {
+        return -1;
+    }
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Turns one sample into a folded stack line, outermost frame first.
+ *
+ * @param[in] sample  Pointer to the `ProfileSample`.
+ * @return            Newly allocated line without the count.
+ */
+static char *profiler_fold_sample(const ProfileSample *sample) {
+    char **symbols = backtrace_symbols((void *const *)sample->frames, sample->depth);
+    size_t length = strlen(profile_role_names[sample->role]) + 1;
+    char *line;
+
+    for (int i = 0; i < sample->depth; i++) {
+        length += strlen(symbols[i]) + 1;
+    }
+    line = (char *)malloc(length);
+    strcpy(line, profile_role_names[sample->role]);
+
+    for (int i = sample->depth - 1; i >= 0; i--) {
+        // Symbols look like "module(function+0x1f) [0x55d0c2]"; keep "function", or "module+0x1f" when unnamed
+        char *open = strchr(symbols[i], '(');
+        char *plus = open ? strchr(open, '+') : NULL;
+        char *close = open ? strchr(open, ')') : NULL;
+        char *base = strrchr(symbols[i], '/');
+        base = base ? base + 1 : symbols[i];
+
+        strcat(line, ";");
+        if (open && plus && plus > open + 1) {
+            strncat(line, open + 1, plus - open - 1);
+        } else if (open && close) {
+            strncat(line, base, open - base);
+            strncat(line, open + 1, close - open - 1);
+        } else {
+            strcat(line, base);
+        }
+    }
+
+    free(symbols);
+    return line;
+}
+
+static int profiler_compare_strings(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
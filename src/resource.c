@@ -2,6 +2,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static int resource_level_reached(const Resource *resource, const System *system);
+static void resource_hand_over(Resource *resource, System *system, int available);
 
 /* Resource functions */
 
@@ -19,10 +26,28 @@
 void resource_create(Resource **resource, const char *name, int amount, int max_capacity) {
     *resource = (Resource *)malloc(sizeof(Resource));
     (*resource)->name = strdup(name);
+    (*resource)->id = -1;
     (*resource)->amount = amount;
     (*resource)->max_capacity = max_capacity;
+    (*resource)->reserved = 0;
+    (*resource)->produced = 0;
+    (*resource)->consumed = 0;
+    (*resource)->producers = (System **)malloc(sizeof(System *) * 1);
+    (*resource)->producer_count = 0;
+    (*resource)->producer_capacity = 1;
+    (*resource)->flow_rate = 0.0;
+    (*resource)->last_sample_time = -1.0;
+    (*resource)->last_sample_amount = amount;
+    (*resource)->forecast_status = STANDARD;
+    (*resource)->control = (ResourceControl *)aligned_alloc(CACHE_LINE_SIZE, sizeof(ResourceControl));
+    (*resource)->control->status = CONTROL_NONE;
+    (*resource)->waiters = NULL;
+    (*resource)->waiter_count = 0;
+    (*resource)->queued_inputs = 0;
+    (*resource)->promised = 0;
+    (*resource)->promised_space = 0;
 
-    sem_init(&(*resource)->lock, 0, 1);
+    lock_init(&(*resource)->lock);
 }
 
 
@@ -35,12 +60,242 @@ void resource_create(Resource **resource, const char *name, int amount, int max_
  */
 void resource_destroy(Resource *resource) {
     if (resource) {
-        sem_destroy(&resource->lock);  
+        lock_destroy(&resource->lock);  
+        free(resource->producers);
+        free(resource->control);
         free(resource->name);
         free(resource);
     }
 }
 
+/**
+ * Records a `System` as a producer of a `Resource`, resizing the producer list if necessary (doubling the size).
+ *
+ * Use of realloc is NOT permitted.
+ *
+ * @param[in,out] resource  Pointer to the `Resource` being produced.
+ * @param[in]     system    Pointer to the `System` producing it.
+ */
+void resource_add_producer(Resource *resource, System *system) {
+    if (resource->producer_count == resource->producer_capacity) {
+        resource->producer_capacity *= 2;
+        System **new_producers = (System **)malloc(sizeof(System *) * resource->producer_capacity);
+        for (int i = 0; i < resource->producer_count; i++) {
+            new_producers[i] = resource->producers[i];
+        }
+        free(resource->producers);
+        resource->producers = new_producers;
+    }
+    resource->producers[resource->producer_count++] = system;
+}
+
+/**
+ * Parks a `System` on the waiter list of a `Resource` until the resource reaches the system's `wait_level`.
+ *
+ * The level is checked again under the lock, so a change made since the system failed is never missed.
+ * A terminating system is not parked.
+ * With `BACKOFF_QUEUE` the list is a queue: the system goes behind every waiter of at least its weight, and a consumer
+ * also parks while other consumers are queued for input, even if the level is reached, so it never overtakes them.
+ * Weights are bounded by aging: a waiter overtaken `SYSTEM_MAX_OVERTAKES` times keeps its place, so a steady stream
+ * of heavier systems delays a lighter one by a bounded number of turns instead of starving it.
+ *
+ * @param[in,out] resource  Pointer to the `Resource` the system is waiting on.
+ * @param[in,out] system    Pointer to the `System`, with `wait_level` and `wait_for_space` already set.
+ * @return                  Non-zero if the system was parked and must now wait on its `wake` semaphore.
+ */
+int resource_park(Resource *resource, System *system) {
+    int queued = (system->backoff_strategy == BACKOFF_QUEUE);
+    int parked = 0;
+
+    lock_acquire(&resource->lock);
+    int behind = queued && !system->wait_for_space && resource->queued_inputs > 0;
+    if (system->status != TERMINATE && (behind || !resource_level_reached(resource, system))) {
+        System **link = &resource->waiters;
+        if (queued) {
+            for (System **cursor = link; *cursor; cursor = &(*cursor)->next_waiter) {
+                if ((*cursor)->weight >= system->weight || (*cursor)->overtaken >= SYSTEM_MAX_OVERTAKES) {
+                    link = &(*cursor)->next_waiter;
+                }
+            }
+            for (System *passed = *link; passed; passed = passed->next_waiter) {
+                passed->overtaken++;
+            }
+        }
+        system->overtaken = 0;
+        system->waiting_on = resource;
+        system->next_waiter = *link;
+        *link = system;
+        resource->waiter_count++;
+        resource->queued_inputs += queued && !system->wait_for_space;
+        parked = 1;
+    }
+    lock_release(&resource->lock);
+    return parked;
+}
+
+/**
+ * Wakes the systems parked on a `Resource` whose level has now been reached.
+ *
+ * Must be called with the resource locked, after its amount changed. Systems whose level is still out of reach
+ * stay parked, so a refill wakes only the consumers it can feed.
+ * `BACKOFF_QUEUE` systems are served in queue order and only while what is left covers them: a consumer is handed
+ * its input directly (see `resource_hand_over`), so it wakes with its cycle started instead of racing for the lock,
+ * and the first one which cannot be served stops the queue behind it. Consumers in reserve mode, which must also
+ * reserve their output, and producers waiting for space are woken with their share set aside for them in `promised`
+ * and `promised_space`, which later calls do not count as available until the woken system takes or releases it.
+ *
+ * @param[in,out] resource  Pointer to the locked `Resource`.
+ */
+void resource_wake_waiters(Resource *resource) {
+    System **link = &resource->waiters;
+    int inputs_blocked = 0, space_blocked = 0;
+
+    while (*link) {
+        System *system = *link;
+        int wake;
+
+        if (system->backoff_strategy != BACKOFF_QUEUE) {
+            wake = resource_level_reached(resource, system);
+        } else if (system->wait_for_space) {
+            int space = resource->max_capacity - resource->amount - resource->reserved - resource->promised_space;
+            wake = !space_blocked && space >= system->wait_level;
+            space_blocked = !wake;
+            if (wake) {
+                system->promised_space = system->reserve_output ? system->wait_level : system->amount_stored;
+                resource->promised_space += system->promised_space;
+            }
+        } else {
+            int available = resource->amount - resource->promised;
+            wake = !inputs_blocked && available >= system->wait_level;
+            inputs_blocked = !wake;
+            if (wake && system->reserve_output) {
+                // Reserving takes the output lock too, so the system takes the input itself on its next attempt
+                resource->promised += system->wait_level;
+                system->promised_input = system->wait_level;
+            } else if (wake) {
+                resource_hand_over(resource, system, available);
+            }
+            resource->queued_inputs -= wake;
+        }
+
+        if (wake) {
+            *link = system->next_waiter;
+            system->waiting_on = NULL;
+            resource->waiter_count--;
+            sem_post(&system->wake);
+        } else {
+            link = &system->next_waiter;
+        }
+    }
+}
+
+/**
+ * Takes the input of a queued consumer's next cycle on its behalf, for as many of its copies as `available` feeds.
+ * Its next `system_consume` then starts the cycle without touching the resource.
+ *
+ * @param[in,out] resource   Pointer to the locked `Resource`.
+ * @param[in,out] system     Pointer to the queued `System`, about to be woken.
+ * @param[in]     available  Units the system may take, at least one copy's worth.
+ */
+static void resource_hand_over(Resource *resource, System *system, int available) {
+    int per_copy = system->consumed.amount;
+    int copies = available / per_copy;
+
+    if (copies > system->multiplicity) {
+        copies = system->multiplicity;
+    }
+    resource->amount -= per_copy * copies;
+    resource->consumed += per_copy * copies;
+    system->granted_copies = copies;
+    if (system->journal) {
+        journal_record(system->journal, JOURNAL_RESOURCE, resource->id, resource->amount);
+    }
+}
+
+/**
+ * Wakes every system parked on a `Resource`, whatever its level, so terminating systems can exit.
+ *
+ * @param[in,out] resource  Pointer to the `Resource`.
+ */
+void resource_wake_all(Resource *resource) {
+    lock_acquire(&resource->lock);
+    while (resource->waiters) {
+        System *system = resource->waiters;
+        resource->waiters = system->next_waiter;
+        system->waiting_on = NULL;
+        sem_post(&system->wake);
+    }
+    resource->waiter_count = 0;
+    resource->queued_inputs = 0;
+    lock_release(&resource->lock);
+}
+
+/**
+ * Checks whether a `Resource` has reached the level a parked `System` is waiting for.
+ * Input and space set aside for woken queued systems do not count.
+ *
+ * @param[in] resource  Pointer to the locked `Resource`.
+ * @param[in] system    Pointer to the waiting `System`.
+ * @return              Non-zero if the system's next attempt can succeed.
+ */
+static int resource_level_reached(const Resource *resource, const System *system) {
+    if (system->wait_for_space) {
+        return resource->max_capacity - resource->amount - resource->reserved - resource->promised_space >=
+               system->wait_level;
+    }
+    return resource->amount - resource->promised >= system->wait_level;
+}
+
+/**
+ * Updates the smoothed net flow rate of a `Resource` with its change since the previous sample.
+ *
+ * The change over the interval is exactly production minus consumption, it is blended into an exponentially
+ * weighted moving average whose weight depends on the interval length (time constant `FORECAST_TAU`),
+ * so irregular sampling is handled and each update costs O(1).
+ *
+ * @param[in,out] resource  Pointer to the `Resource`.
+ * @param[in]     now       Current simulated time in milliseconds.
+ */
+void resource_forecast_update(Resource *resource, double now) {
+    int amount = resource->amount;
+
+    if (resource->last_sample_time >= 0.0 && now > resource->last_sample_time) {
+        double dt = now - resource->last_sample_time;
+        double rate = (amount - resource->last_sample_amount) / dt;
+        double weight = 1.0 - exp(-dt / FORECAST_TAU);
+        resource->flow_rate += weight * (rate - resource->flow_rate);
+    }
+
+    resource->last_sample_time = now;
+    resource->last_sample_amount = amount;
+}
+
+/**
+ * Estimates how long until a `Resource` runs out at its current flow rate.
+ *
+ * @param[in] resource  Pointer to the `Resource`.
+ * @return              Milliseconds until empty, or `INFINITY` if it is not draining.
+ */
+double resource_time_to_empty(const Resource *resource) {
+    if (resource->flow_rate >= 0.0) {
+        return INFINITY;
+    }
+    return resource->last_sample_amount / -resource->flow_rate;
+}
+
+/**
+ * Estimates how long until a `Resource` reaches its capacity at its current flow rate.
+ *
+ * @param[in] resource  Pointer to the `Resource`.
+ * @return              Milliseconds until full, or `INFINITY` if it is not filling.
+ */
+double resource_time_to_full(const Resource *resource) {
+    if (resource->flow_rate <= 0.0) {
+        return INFINITY;
+    }
+    return (resource->max_capacity - resource->last_sample_amount) / resource->flow_rate;
+}
+
 /* ResourceAmount functions */
 
 /**
@@ -89,6 +344,7 @@ void resource_array_clean(ResourceArray *array) {
  * Adds a `Resource` to the `ResourceArray`, resizing if necessary (doubling the size).
  *
  * Resizes the array when the capacity is reached and adds the new `Resource`.
+ * The resource's `id` is set to its index in the array.
  * Use of realloc is NOT permitted.
  * 
  * @param[in,out] array     Pointer to the `ResourceArray`.
@@ -104,5 +360,6 @@ void resource_array_add(ResourceArray *array, Resource *resource) {
         free(array->resources);
         array->resources = new_array;
     }
+    resource->id = array->size;
     array->resources[array->size++] = resource;
 }
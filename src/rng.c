@@ -0,0 +1,101 @@
+#include "defs.h"
+#include <math.h>
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static uint64_t splitmix64(uint64_t *x);
+static uint64_t rotl(uint64_t x, int k);
+
+/* Rng functions */
+
+/**
+ * Seeds an `Rng` deterministically from a seed and a stream number.
+ *
+ * Each (seed, stream) pair produces an independent sequence, so giving every system its own
+ * stream (its id) keeps runs reproducible by seed without any shared generator or lock.
+ *
+ * @param[out] rng     Pointer to the `Rng` to seed.
+ * @param[in]  seed    Seed shared by the whole simulation.
+ * @param[in]  stream  Stream number, unique per user of the generator.
+ */
+void rng_seed(Rng *rng, uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ (stream * 0x9e3779b97f4a7c15ULL);
+
+    for (int i = 0; i < 4; i++) {
+        rng->state[i] = splitmix64(&x);
+    }
+}
+
+/**
+ * Returns the next 64 random bits of an `Rng` (xoshiro256**).
+ *
+ * @param[in,out] rng  Pointer to the `Rng`.
+ * @return             64 uniformly distributed bits.
+ */
+uint64_t rng_next(Rng *rng) {
+    uint64_t *s = rng->state;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+/**
+ * Returns a uniformly distributed double in [0, 1).
+ *
+ * @param[in,out] rng  Pointer to the `Rng`.
+ * @return             A value in [0, 1).
+ */
+double rng_uniform(Rng *rng) {
+    return (rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+/**
+ * Returns a standard normally distributed double (mean 0, standard deviation 1).
+ *
+ * Uses the Box-Muller transform.
+ *
+ * @param[in,out] rng  Pointer to the `Rng`.
+ * @return             A normally distributed value.
+ */
+double rng_normal(Rng *rng) {
+    double u1 = 1.0 - rng_uniform(rng);  // (0, 1] so the log is finite
+    double u2 = rng_uniform(rng);
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/**
+ * Returns an exponentially distributed double with mean 1.
+ *
+ * @param[in,out] rng  Pointer to the `Rng`.
+ * @return             An exponentially distributed value.
+ */
+double rng_exponential(Rng *rng) {
+    return -log(1.0 - rng_uniform(rng));
+}
+
+/**
+ * Advances a splitmix64 state, used only to expand seeds into full generator states.
+ *
+ * @param[in,out] x  Pointer to the splitmix64 state.
+ * @return           The next 64 bit output.
+ */
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
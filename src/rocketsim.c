@@ -0,0 +1,181 @@
+#include "defs.h"
+#include "rocketsim.h"
+#include <stdlib.h>
+#include <string.h>
+
+_Static_assert(ROCKETSIM_TERMINATE == TERMINATE && ROCKETSIM_DISABLED == DISABLED && ROCKETSIM_SLOW == SLOW &&
+               ROCKETSIM_STANDARD == STANDARD && ROCKETSIM_FAST == FAST, "public statuses must match defs.h");
+
+// A simulation driven through the library interface, opaque to users of rocketsim.h
+struct RocketSim {
+    Manager manager;
+    Stepper stepper;
+    int stepper_ready;  // zero when systems were added since the stepper was last resized
+};
+
+/**
+ * Creates an empty simulation.
+ *
+ * @param[in] seed  Seed for the systems' random streams.
+ * @return          Pointer to the new `RocketSim`, to be released with `rocketsim_destroy`.
+ */
+RocketSim *rocketsim_init(uint64_t seed) {
+    RocketSim *sim = (RocketSim *)malloc(sizeof(RocketSim));
+    manager_init(&sim->manager);
+    sim->manager.display_enabled = 0;
+    sim->manager.seed = seed;
+    stepper_init(&sim->stepper, &sim->manager);
+    sim->stepper_ready = 1;
+    return sim;
+}
+
+/**
+ * Destroys a simulation and everything it owns.
+ *
+ * @param[in,out] sim  Pointer to the `RocketSim` to destroy.
+ */
+void rocketsim_destroy(RocketSim *sim) {
+    if (sim) {
+        stepper_clean(&sim->stepper);
+        manager_clean(&sim->manager);
+        free(sim);
+    }
+}
+
+/**
+ * Loads the sample resources and systems (Fuel, Oxygen, Energy, Distance and four systems).
+ *
+ * @param[in,out] sim  Pointer to the `RocketSim`.
+ */
+void rocketsim_load_default(RocketSim *sim) {
+    load_data(&sim->manager);
+    manager_seed(&sim->manager, sim->manager.seed);
+    sim->stepper_ready = 0;
+}
+
+/**
+ * Adds a resource to the simulation.
+ *
+ * @param[in,out] sim           Pointer to the `RocketSim`.
+ * @param[in]     name          Name of the resource (the string is copied).
+ * @param[in]     amount        Initial amount.
+ * @param[in]     max_capacity  Maximum capacity.
+ * @return                      Id of the new resource.
+ */
+int rocketsim_add_resource(RocketSim *sim, const char *name, int amount, int max_capacity) {
+    Resource *resource;
+    resource_create(&resource, name, amount, max_capacity);
+    resource_array_add(&sim->manager.resource_array, resource);
+    return resource->id;
+}
+
+/**
+ * Adds a system to the simulation.
+ *
+ * @param[in,out] sim              Pointer to the `RocketSim`.
+ * @param[in]     name             Name of the system (the string is copied).
+ * @param[in]     consumed_id      Id of the consumed resource, or -1 if it consumes nothing.
+ * @param[in]     consumed_amount  Amount consumed per cycle.
+ * @param[in]     produced_id      Id of the produced resource, or -1 if it produces nothing.
+ * @param[in]     produced_amount  Amount produced per cycle.
+ * @param[in]     processing_time  Processing time of a cycle in milliseconds.
+ * @return                         Id of the new system, or -1 if a resource id is invalid.
+ */
+int rocketsim_add_system(RocketSim *sim, const char *name, int consumed_id, int consumed_amount,
+                         int produced_id, int produced_amount, int processing_time) {
+    ResourceArray *resources = &sim->manager.resource_array;
+    ResourceAmount consumed, produced;
+    System *system;
+
+    if (consumed_id >= resources->size || produced_id >= resources->size) {
+        return -1;
+    }
+
+    resource_amount_init(&consumed, (consumed_id >= 0) ? resources->resources[consumed_id] : NULL, consumed_amount);
+    resource_amount_init(&produced, (produced_id >= 0) ? resources->resources[produced_id] : NULL, produced_amount);
+    system_create(&system, name, consumed, produced, processing_time, &sim->manager.event_queue);
+    manager_add_system(&sim->manager, system);
+
+    sim->stepper_ready = 0;
+    return system->id;
+}
+
+/**
+ * Advances the simulation by `dt` virtual milliseconds.
+ *
+ * Allocates only on the first step after systems were added (and if the event queue grows deeper than before).
+ *
+ * @param[in,out] sim  Pointer to the `RocketSim`.
+ * @param[in]     dt   Virtual milliseconds to advance.
+ * @return             Non-zero while the simulation is still running.
+ */
+int rocketsim_step(RocketSim *sim, double dt) {
+    if (!sim->stepper_ready) {
+        manager_prune(&sim->manager);
+        stepper_resize(&sim->stepper, &sim->manager);
+        sim->stepper_ready = 1;
+    }
+
+    stepper_advance(&sim->stepper, &sim->manager, dt);
+    return sim->manager.simulation_running;
+}
+
+double rocketsim_time(const RocketSim *sim) {
+    return sim->stepper.time;
+}
+
+int rocketsim_running(const RocketSim *sim) {
+    return sim->manager.simulation_running;
+}
+
+int rocketsim_resource_count(const RocketSim *sim) {
+    return sim->manager.resource_array.size;
+}
+
+/**
+ * Looks up a resource by name.
+ *
+ * @param[in] sim   Pointer to the `RocketSim`.
+ * @param[in] name  Name of the resource.
+ * @return          Id of the first resource with that name, or -1 if there is none.
+ */
+int rocketsim_find_resource(const RocketSim *sim, const char *name) {
+    for (int i = 0; i < sim->manager.resource_array.size; i++) {
+        if (strcmp(sim->manager.resource_array.resources[i]->name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Returns the current amount of a resource.
+ *
+ * @param[in] sim          Pointer to the `RocketSim`.
+ * @param[in] resource_id  Id of the resource.
+ * @return                 The amount, or -1 if the id is invalid.
+ */
+int rocketsim_resource_amount(const RocketSim *sim, int resource_id) {
+    if (resource_id < 0 || resource_id >= sim->manager.resource_array.size) {
+        return -1;
+    }
+    return sim->manager.resource_array.resources[resource_id]->amount;
+}
+
+int rocketsim_system_count(const RocketSim *sim) {
+    return sim->manager.system_array.size;
+}
+
+/**
+ * Returns the current status of a system.
+ *
+ * @param[in] sim        Pointer to the `RocketSim`.
+ * @param[in] system_id  Id of the system.
+ * @return               One of the ROCKETSIM_ statuses, or -1 if the id is invalid.
+ */
+int rocketsim_system_status(const RocketSim *sim, int system_id) {
+    if (system_id < 0 || system_id >= sim->manager.system_array.size) {
+        return -1;
+    }
+    return system_speed(sim->manager.system_array.systems[system_id]);
+}
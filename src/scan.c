@@ -0,0 +1,188 @@
+#include "defs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_HAVE_AVX2 1   // The AVX2 compare can be built, it is still only used if the processor supports it
+#endif
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static void threshold_scan_compare_scalar(ThresholdScan *scan);
+#ifdef SCAN_HAVE_AVX2
+static void threshold_scan_compare_avx2(ThresholdScan *scan);
+#endif
+
+/**
+ * Initializes a `ThresholdScan` for the resources and systems currently held by a `Manager`.
+ *
+ * All memory is allocated here, gathering and comparing afterwards does not allocate.
+ * A resource nothing consumes is never reported empty or low, and one nothing produces is never reported full,
+ * matching the events systems would have sent.
+ *
+ * @param[out] scan     Pointer to the `ThresholdScan` to initialize.
+ * @param[in]  manager  Pointer to the `Manager` whose resources will be scanned.
+ */
+void threshold_scan_init(ThresholdScan *scan, Manager *manager) {
+    int count = manager->resource_array.size;
+    int words = (count + SCAN_WORD_BITS - 1) / SCAN_WORD_BITS;
+    int padded = (words > 0 ? words : 1) * SCAN_WORD_BITS;
+
+    scan->count = count;
+    scan->system_count = manager->system_array.size;
+    scan->words = words;
+#ifdef SCAN_HAVE_AVX2
+    scan->use_simd = __builtin_cpu_supports("avx2");
+#else
+    scan->use_simd = 0;
+#endif
+
+    scan->amounts = (int *)malloc(sizeof(int) * padded);
+    scan->empty_below = (int *)malloc(sizeof(int) * padded);
+    scan->low_below = (int *)malloc(sizeof(int) * padded);
+    scan->full_above = (int *)malloc(sizeof(int) * padded);
+    for (int m = 0; m < SCAN_MASKS; m++) {
+        scan->masks[m] = (uint64_t *)calloc(words > 0 ? words : 1, sizeof(uint64_t));
+        scan->previous[m] = (uint64_t *)calloc(words > 0 ? words : 1, sizeof(uint64_t));
+    }
+    scan->consumers = (System **)calloc(padded, sizeof(System *));
+    scan->producers = (System **)calloc(padded, sizeof(System *));
+
+    for (int i = 0; i < manager->system_array.size; i++) {
+        System *system = manager->system_array.systems[i];
+        if (system->consumed.resource && !scan->consumers[system->consumed.resource->id]) {
+            scan->consumers[system->consumed.resource->id] = system;
+        }
+        if (system->produced.resource && !scan->producers[system->produced.resource->id]) {
+            scan->producers[system->produced.resource->id] = system;
+        }
+    }
+
+    for (int r = 0; r < padded; r++) {
+        Resource *resource = (r < count) ? manager->resource_array.resources[r] : NULL;
+        scan->amounts[r] = 0;
+        scan->empty_below[r] = (resource && scan->consumers[r]) ? 1 : INT_MIN;
+        scan->low_below[r] = (resource && scan->consumers[r]) ? (int)ceil(resource->max_capacity * THRESHOLD_RESOURCE_LOW) : INT_MIN;
+        scan->full_above[r] = (resource && scan->producers[r]) ? resource->max_capacity - 1 : INT_MAX;
+    }
+}
+
+/**
+ * Cleans up a `ThresholdScan`, freeing all of its arrays.
+ *
+ * @param[in,out] scan  Pointer to the `ThresholdScan` to clean.
+ */
+void threshold_scan_clean(ThresholdScan *scan) {
+    free(scan->amounts);
+    free(scan->empty_below);
+    free(scan->low_below);
+    free(scan->full_above);
+    for (int m = 0; m < SCAN_MASKS; m++) {
+        free(scan->masks[m]);
+        free(scan->previous[m]);
+    }
+    free(scan->consumers);
+    free(scan->producers);
+    memset(scan, 0, sizeof(ThresholdScan));
+}
+
+/**
+ * Copies the current amount of every resource into the contiguous `amounts` array.
+ *
+ * Amounts are read without locking, like the display does: a value a few units stale is picked up on the next tick.
+ *
+ * @param[in,out] scan     Pointer to the `ThresholdScan`.
+ * @param[in]     manager  Pointer to the `Manager` the scan was built for.
+ */
+void threshold_scan_gather(ThresholdScan *scan, Manager *manager) {
+    Resource **resources = manager->resource_array.resources;
+
+    for (int r = 0; r < scan->count; r++) {
+        scan->amounts[r] = __atomic_load_n(&resources[r]->amount, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Compares every gathered amount against its thresholds and rebuilds the `SCAN_` bitmasks.
+ *
+ * The previous masks are kept in `previous` so the caller can act only on resources which just crossed a threshold.
+ * Uses AVX2 when `use_simd` is set, eight resources per compare, and a scalar loop otherwise.
+ *
+ * @param[in,out] scan  Pointer to the `ThresholdScan`.
+ */
+void threshold_scan_compare(ThresholdScan *scan) {
+    for (int m = 0; m < SCAN_MASKS; m++) {
+        uint64_t *swap = scan->previous[m];
+        scan->previous[m] = scan->masks[m];
+        scan->masks[m] = swap;
+    }
+
+#ifdef SCAN_HAVE_AVX2
+    if (scan->use_simd) {
+        threshold_scan_compare_avx2(scan);
+        return;
+    }
+#endif
+    threshold_scan_compare_scalar(scan);
+}
+
+/**
+ * Portable version of the compare, one resource at a time.
+ *
+ * @param[in,out] scan  Pointer to the `ThresholdScan`.
+ */
+static void threshold_scan_compare_scalar(ThresholdScan *scan) {
+    for (int w = 0; w < scan->words; w++) {
+        uint64_t empty = 0, low = 0, full = 0;
+        int base = w * SCAN_WORD_BITS;
+
+        for (int b = 0; b < SCAN_WORD_BITS; b++) {
+            int amount = scan->amounts[base + b];
+            empty |= (uint64_t)(amount < scan->empty_below[base + b]) << b;
+            low |= (uint64_t)(amount < scan->low_below[base + b]) << b;
+            full |= (uint64_t)(amount > scan->full_above[base + b]) << b;
+        }
+
+        scan->masks[SCAN_EMPTY][w] = empty;
+        scan->masks[SCAN_LOW][w] = low;
+        scan->masks[SCAN_FULL][w] = full;
+    }
+}
+
+#ifdef SCAN_HAVE_AVX2
+/**
+ * AVX2 version of the compare: each 256-bit compare yields eight lanes, `movemask` packs their sign bits
+ * into eight bits of the word.
+ *
+ * @param[in,out] scan  Pointer to the `ThresholdScan`.
+ */
+__attribute__((target("avx2")))
+static void threshold_scan_compare_avx2(ThresholdScan *scan) {
+    for (int w = 0; w < scan->words; w++) {
+        uint64_t empty = 0, low = 0, full = 0;
+        int base = w * SCAN_WORD_BITS;
+
+        for (int b = 0; b < SCAN_WORD_BITS; b += 8) {
+            __m256i amounts = _mm256_loadu_si256((const __m256i *)&scan->amounts[base + b]);
+            __m256i empty_below = _mm256_loadu_si256((const __m256i *)&scan->empty_below[base + b]);
+            __m256i low_below = _mm256_loadu_si256((const __m256i *)&scan->low_below[base + b]);
+            __m256i full_above = _mm256_loadu_si256((const __m256i *)&scan->full_above[base + b]);
+
+            empty |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(empty_below, amounts))) << b;
+            low |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(low_below, amounts))) << b;
+            full |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(amounts, full_above))) << b;
+        }
+
+        scan->masks[SCAN_EMPTY][w] = empty;
+        scan->masks[SCAN_LOW][w] = low;
+        scan->masks[SCAN_FULL][w] = full;
+    }
+
+    // Leaving the upper halves of the registers dirty makes every later SSE instruction (libm included) pay a
+    // transition penalty, and the compiler only adds this itself when optimizing
+    _mm256_zeroupper();
+}
+#endif
@@ -0,0 +1,97 @@
+#include "defs.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Loads sample data for the simulation.
+ *
+ * Calls all of the functions required to create resources and systems and add them to the Manager's data.
+ *
+ * @param[in,out] manager  Pointer to the `Manager` to populate with resource and system data.
+ */
+void load_data(Manager *manager) {
+    // Create resources
+    Resource *fuel, *oxygen, *energy, *distance;
+    resource_create(&fuel, "Fuel", 1000, 1000);
+    resource_create(&oxygen, "Oxygen", 20, 50);
+    resource_create(&energy, "Energy", 30, 50);
+    resource_create(&distance, "Distance", 0, 5000);
+
+    resource_array_add(&manager->resource_array, fuel);
+    resource_array_add(&manager->resource_array, oxygen);
+    resource_array_add(&manager->resource_array, energy);
+    resource_array_add(&manager->resource_array, distance);
+
+    // Create systems
+    System *propulsion_system, *life_support_system, *crew_capsule_system, *generator_system;
+    ResourceAmount consume_fuel, produce_distance;
+    resource_amount_init(&consume_fuel, fuel, 5);
+    resource_amount_init(&produce_distance, distance, 25);
+    system_create(&propulsion_system, "Propulsion", consume_fuel, produce_distance, 50, &manager->event_queue);
+
+    ResourceAmount consume_energy, produce_oxygen;
+    resource_amount_init(&consume_energy, energy, 7);
+    resource_amount_init(&produce_oxygen, oxygen, 4);
+    system_create(&life_support_system, "Life Support", consume_energy, produce_oxygen, 10, &manager->event_queue);
+
+    ResourceAmount consume_oxygen, produce_nothing;
+    resource_amount_init(&consume_oxygen, oxygen, 1);
+    resource_amount_init(&produce_nothing, NULL, 0);
+    system_create(&crew_capsule_system, "Crew", consume_oxygen, produce_nothing, 2, &manager->event_queue);
+
+    ResourceAmount consume_fuel_for_energy, produce_energy;
+    resource_amount_init(&consume_fuel_for_energy, fuel, 5);
+    resource_amount_init(&produce_energy, energy, 10);
+    system_create(&generator_system, "Generator", consume_fuel_for_energy, produce_energy, 20, &manager->event_queue);
+
+    system_array_add(&manager->system_array, propulsion_system);
+    system_array_add(&manager->system_array, life_support_system);
+    system_array_add(&manager->system_array, crew_capsule_system);
+    system_array_add(&manager->system_array, generator_system);
+}
+
+/**
+ * Gives the sample systems randomly varying processing times.
+ *
+ * Must be called after `load_data`, systems are looked up by the order in which they were added
+ * (every copy of the sample data adds the same four systems).
+ *
+ * @param[in,out] manager  Pointer to the `Manager` holding the sample systems.
+ */
+void load_distributions(Manager *manager) {
+    System **systems = manager->system_array.systems;
+
+    for (int i = 0; i + 3 < manager->system_array.size; i += 4) {
+        system_set_distribution(systems[i], DIST_NORMAL, 10.0);         // Propulsion
+        system_set_distribution(systems[i + 1], DIST_UNIFORM, 5.0);     // Life Support
+        system_set_distribution(systems[i + 2], DIST_EXPONENTIAL, 0.0); // Crew
+        system_set_distribution(systems[i + 3], DIST_NORMAL, 4.0);      // Generator
+    }
+}
+
+/**
+ * Grows the crew of every capsule in the sample data to `crew` members.
+ *
+ * Each extra member is an identical copy of the "Crew" system (same input, output, processing time and distribution),
+ * so large crews can be merged back into one system with `manager_aggregate`.
+ * Must be called after `load_distributions`, which relies on the systems being in groups of four.
+ *
+ * @param[in,out] manager  Pointer to the `Manager` holding the sample systems.
+ * @param[in]     crew     Number of crew members per capsule, values below 2 change nothing.
+ */
+void load_crew(Manager *manager, int crew) {
+    int size = manager->system_array.size;
+
+    for (int i = 0; i < size; i++) {
+        System *member = manager->system_array.systems[i];
+        if (strcmp(member->name, "Crew") != 0) {
+            continue;
+        }
+        for (int j = 1; j < crew; j++) {
+            System *copy;
+            system_create(&copy, member->name, member->consumed, member->produced, member->processing_time, member->event_queue);
+            system_set_distribution(copy, member->distribution, member->spread);
+            system_array_add(&manager->system_array, copy);
+        }
+    }
+}
@@ -0,0 +1,286 @@
+#include "defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Helper functions just used by this C file to manage the shared chunks and tables
+// Using static means they can't get linked into other files
+
+static void persistent_chunk_release(PersistentChunk *chunk);
+static void persistent_table_release(PersistentTable *table);
+static PersistentChunk *persistent_array_writable_chunk(PersistentArray *array, int chunk_index);
+
+/* PersistentArray functions */
+
+/**
+ * Initializes a `PersistentArray` of `size` values, all set to zero.
+ *
+ * The array owns a table of chunks which may later be shared with snapshots.
+ *
+ * @param[out] array  Pointer to the `PersistentArray` to initialize.
+ * @param[in]  size   Number of values held by the array.
+ */
+void persistent_array_init(PersistentArray *array, int size) {
+    PersistentTable *table = (PersistentTable *)malloc(sizeof(PersistentTable));
+    table->refs = 1;
+    table->chunk_count = (size + STATE_CHUNK_SIZE - 1) / STATE_CHUNK_SIZE;
+    table->chunks = (PersistentChunk **)malloc(sizeof(PersistentChunk *) * (table->chunk_count > 0 ? table->chunk_count : 1));
+
+    for (int i = 0; i < table->chunk_count; i++) {
+        table->chunks[i] = (PersistentChunk *)calloc(1, sizeof(PersistentChunk));
+        table->chunks[i]->refs = 1;
+    }
+
+    array->table = table;
+    array->size = size;
+}
+
+/**
+ * Cleans up a `PersistentArray`.
+ *
+ * Releases this array's reference to its table; memory still shared with other snapshots is kept alive.
+ *
+ * @param[in,out] array  Pointer to the `PersistentArray` to clean.
+ */
+void persistent_array_clean(PersistentArray *array) {
+    persistent_table_release(array->table);
+    array->table = NULL;
+    array->size = 0;
+}
+
+/**
+ * Takes a snapshot of a `PersistentArray` in constant time.
+ *
+ * The snapshot shares the table (and therefore every chunk) of the source array.
+ * Whichever of the two is written to first copies only the table and the chunk it modifies.
+ *
+ * @param[in]  source    Pointer to the `PersistentArray` to snapshot.
+ * @param[out] snapshot  Pointer to the `PersistentArray` which will share the source's data.
+ */
+void persistent_array_snapshot(const PersistentArray *source, PersistentArray *snapshot) {
+    __atomic_add_fetch(&source->table->refs, 1, __ATOMIC_RELAXED);
+    snapshot->table = source->table;
+    snapshot->size = source->size;
+}
+
+/**
+ * Reads a value from a `PersistentArray`.
+ *
+ * @param[in] array  Pointer to the `PersistentArray`.
+ * @param[in] index  Index of the value to read.
+ * @return           The value stored at `index`.
+ */
+int persistent_array_get(const PersistentArray *array, int index) {
+    return array->table->chunks[index / STATE_CHUNK_SIZE]->values[index % STATE_CHUNK_SIZE];
+}
+
+/**
+ * Writes a value to a `PersistentArray`.
+ *
+ * Copies the table and the affected chunk first if they are shared with a snapshot,
+ * so other snapshots never observe the write.
+ *
+ * @param[in,out] array  Pointer to the `PersistentArray`.
+ * @param[in]     index  Index of the value to write.
+ * @param[in]     value  The new value.
+ */
+void persistent_array_set(PersistentArray *array, int index, int value) {
+    PersistentChunk *chunk = persistent_array_writable_chunk(array, index / STATE_CHUNK_SIZE);
+    chunk->values[index % STATE_CHUNK_SIZE] = value;
+}
+
+/**
+ * Returns a chunk of the array which is not shared with any snapshot.
+ *
+ * Copies the chunk table if other arrays still point at it, then copies the chunk itself if needed.
+ *
+ * @param[in,out] array        Pointer to the `PersistentArray`.
+ * @param[in]     chunk_index  Index of the chunk which is about to be modified.
+ * @return                     A chunk owned exclusively by `array`.
+ */
+static PersistentChunk *persistent_array_writable_chunk(PersistentArray *array, int chunk_index) {
+    PersistentTable *table = array->table;
+
+    if (__atomic_load_n(&table->refs, __ATOMIC_ACQUIRE) > 1) {
+        PersistentTable *copy = (PersistentTable *)malloc(sizeof(PersistentTable));
+        copy->refs = 1;
+        copy->chunk_count = table->chunk_count;
+        copy->chunks = (PersistentChunk **)malloc(sizeof(PersistentChunk *) * (table->chunk_count > 0 ? table->chunk_count : 1));
+        for (int i = 0; i < table->chunk_count; i++) {
+            copy->chunks[i] = table->chunks[i];
+            __atomic_add_fetch(&copy->chunks[i]->refs, 1, __ATOMIC_RELAXED);
+        }
+        persistent_table_release(table);
+        array->table = table = copy;
+    }
+
+    PersistentChunk *chunk = table->chunks[chunk_index];
+    if (__atomic_load_n(&chunk->refs, __ATOMIC_ACQUIRE) > 1) {
+        PersistentChunk *copy = (PersistentChunk *)malloc(sizeof(PersistentChunk));
+        copy->refs = 1;
+        memcpy(copy->values, chunk->values, sizeof(chunk->values));
+        persistent_chunk_release(chunk);
+        table->chunks[chunk_index] = chunk = copy;
+    }
+
+    return chunk;
+}
+
+/**
+ * Drops one reference to a chunk, freeing it when no table uses it anymore.
+ *
+ * @param[in,out] chunk  Pointer to the `PersistentChunk` to release.
+ */
+static void persistent_chunk_release(PersistentChunk *chunk) {
+    if (__atomic_sub_fetch(&chunk->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(chunk);
+    }
+}
+
+/**
+ * Drops one reference to a table, freeing it (and releasing its chunks) when no array uses it anymore.
+ *
+ * @param[in,out] table  Pointer to the `PersistentTable` to release.
+ */
+static void persistent_table_release(PersistentTable *table) {
+    if (table && __atomic_sub_fetch(&table->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        for (int i = 0; i < table->chunk_count; i++) {
+            persistent_chunk_release(table->chunks[i]);
+        }
+        free(table->chunks);
+        free(table);
+    }
+}
+
+/* SimState functions */
+
+/**
+ * Captures the current state of the simulation into a `SimState`.
+ *
+ * Copies every resource amount (under the resource lock) and every system's stored amount and status.
+ * This is the only full copy; every branch taken afterwards with `sim_state_snapshot` is constant time.
+ *
+ * @param[out] state    Pointer to the `SimState` to fill.
+ * @param[in]  manager  Pointer to the `Manager` holding the live simulation.
+ */
+void sim_state_capture(SimState *state, Manager *manager) {
+    persistent_array_init(&state->resource_amounts, manager->resource_array.size);
+    persistent_array_init(&state->system_stored, manager->system_array.size);
+    persistent_array_init(&state->system_status, manager->system_array.size);
+
+    for (int i = 0; i < manager->resource_array.size; i++) {
+        Resource *resource = manager->resource_array.resources[i];
+        lock_acquire(&resource->lock);
+        persistent_array_set(&state->resource_amounts, i, resource->amount);
+        lock_release(&resource->lock);
+    }
+
+    for (int i = 0; i < manager->system_array.size; i++) {
+        System *system = manager->system_array.systems[i];
+        persistent_array_set(&state->system_stored, i, system->amount_stored);
+        persistent_array_set(&state->system_status, i, system->status);
+    }
+}
+
+/**
+ * Branches a `SimState` in constant time.
+ *
+ * @param[in]  source    Pointer to the `SimState` to branch from.
+ * @param[out] snapshot  Pointer to the `SimState` which will share the source's data.
+ */
+void sim_state_snapshot(const SimState *source, SimState *snapshot) {
+    persistent_array_snapshot(&source->resource_amounts, &snapshot->resource_amounts);
+    persistent_array_snapshot(&source->system_stored, &snapshot->system_stored);
+    persistent_array_snapshot(&source->system_status, &snapshot->system_status);
+}
+
+/**
+ * Writes a `SimState` back into the live simulation.
+ *
+ * Should only be used while the system threads are not running, as stored amounts and statuses are written without locking.
+ *
+ * @param[in]     state    Pointer to the `SimState` to restore.
+ * @param[in,out] manager  Pointer to the `Manager` to overwrite.
+ */
+void sim_state_restore(const SimState *state, Manager *manager) {
+    for (int i = 0; i < manager->resource_array.size && i < state->resource_amounts.size; i++) {
+        Resource *resource = manager->resource_array.resources[i];
+        lock_acquire(&resource->lock);
+        resource->amount = persistent_array_get(&state->resource_amounts, i);
+        lock_release(&resource->lock);
+    }
+
+    for (int i = 0; i < manager->system_array.size && i < state->system_stored.size; i++) {
+        System *system = manager->system_array.systems[i];
+        system->amount_stored = persistent_array_get(&state->system_stored, i);
+        system->status = persistent_array_get(&state->system_status, i);
+    }
+}
+
+/**
+ * Cleans up a `SimState`, releasing its share of the persistent arrays.
+ *
+ * @param[in,out] state  Pointer to the `SimState` to clean.
+ */
+void sim_state_clean(SimState *state) {
+    persistent_array_clean(&state->resource_amounts);
+    persistent_array_clean(&state->system_stored);
+    persistent_array_clean(&state->system_status);
+}
+
+/**
+ * Runs a single cycle of a system against a `SimState` instead of the live resources.
+ *
+ * Mirrors `system_run` without sleeping: consumes the input if nothing is stored (for as many copies of an
+ * aggregated system as the input allows), then stores as much output as fits.
+ * Only the chunks touched by the cycle are copied, so a branch pays only for what it modifies.
+ *
+ * @param[in,out] state      Pointer to the `SimState` to advance.
+ * @param[in]     manager    Pointer to the `Manager` describing the systems and resource capacities.
+ * @param[in]     system_id  Id of the system whose cycle is applied.
+ * @return                   `STATUS_OK` if the cycle completed, or the status of the failed step.
+ */
+int sim_state_cycle(SimState *state, const Manager *manager, int system_id) {
+    System *system = manager->system_array.systems[system_id];
+    Resource *consumed_resource = system->consumed.resource;
+    Resource *produced_resource = system->produced.resource;
+    int stored = persistent_array_get(&state->system_stored, system_id);
+
+    if (persistent_array_get(&state->system_status, system_id) == TERMINATE) {
+        return STATUS_OK;
+    }
+
+    if (stored == 0) {
+        int copies = system->multiplicity;
+        if (consumed_resource) {
+            int amount = persistent_array_get(&state->resource_amounts, consumed_resource->id);
+            if (system->consumed.amount > 0 && amount / system->consumed.amount < copies) {
+                copies = amount / system->consumed.amount;
+            }
+            if (copies <= 0) {
+                return (amount == 0) ? STATUS_EMPTY : STATUS_INSUFFICIENT;
+            }
+            persistent_array_set(&state->resource_amounts, consumed_resource->id, amount - system->consumed.amount * copies);
+        }
+        if (produced_resource) {
+            stored = system->produced.amount * copies;
+        }
+    }
+
+    if (produced_resource && stored > 0) {
+        int amount = persistent_array_get(&state->resource_amounts, produced_resource->id);
+        int available_space = produced_resource->max_capacity - amount;
+        int to_store = (available_space < stored) ? available_space : stored;
+
+        if (to_store > 0) {
+            persistent_array_set(&state->resource_amounts, produced_resource->id, amount + to_store);
+            stored -= to_store;
+        }
+        persistent_array_set(&state->system_stored, system_id, stored);
+        if (stored > 0) {
+            return STATUS_CAPACITY;
+        }
+    }
+
+    return STATUS_OK;
+}
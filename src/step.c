@@ -0,0 +1,218 @@
+#include "defs.h"
+#include <stdlib.h>
+#include <math.h>
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static void stepper_run_system(Stepper *stepper, Manager *manager, int system_id);
+static int stepper_earlier(const Stepper *stepper, int a, int b);
+static void stepper_sift_down(Stepper *stepper, int index);
+
+/**
+ * Initializes a `Stepper` for the systems currently held by a `Manager`.
+ *
+ * All memory is allocated here, advancing the stepper afterwards does not allocate.
+ * Call `stepper_resize` if systems are added to the manager later.
+ *
+ * @param[out] stepper  Pointer to the `Stepper` to initialize.
+ * @param[in]  manager  Pointer to the `Manager` whose systems will be scheduled.
+ */
+void stepper_init(Stepper *stepper, Manager *manager) {
+    stepper->time = 0.0;
+    stepper->next_manager_time = 0.0;
+    stepper->count = 0;
+    stepper->heap = NULL;
+    stepper->next_times = NULL;
+    stepper->phases = NULL;
+    stepper_resize(stepper, manager);
+}
+
+/**
+ * Schedules systems added to the manager since the `Stepper` was initialized or last resized.
+ *
+ * Existing systems keep their phase and next action time; new systems, and systems no longer parked, start at the
+ * current virtual time.
+ * Use of realloc is NOT permitted.
+ *
+ * @param[in,out] stepper  Pointer to the `Stepper`.
+ * @param[in]     manager  Pointer to the `Manager` whose systems are scheduled.
+ */
+void stepper_resize(Stepper *stepper, Manager *manager) {
+    int count = manager->system_array.size;
+    int *heap = (int *)malloc(sizeof(int) * (count > 0 ? count : 1));
+    double *next_times = (double *)malloc(sizeof(double) * (count > 0 ? count : 1));
+    int *phases = (int *)malloc(sizeof(int) * (count > 0 ? count : 1));
+
+    for (int i = 0; i < count; i++) {
+        heap[i] = i;
+        next_times[i] = (i < stepper->count) ? stepper->next_times[i] : stepper->time;
+        phases[i] = (i < stepper->count) ? stepper->phases[i] : STEP_WAITING_INPUT;
+        // A system woken by `manager_prune` was unscheduled while parked
+        if (isinf(next_times[i]) && !manager->system_array.systems[i]->parked &&
+            manager->system_array.systems[i]->status != TERMINATE) {
+            next_times[i] = stepper->time;
+        }
+    }
+
+    free(stepper->heap);
+    free(stepper->next_times);
+    free(stepper->phases);
+    stepper->heap = heap;
+    stepper->next_times = next_times;
+    stepper->phases = phases;
+    stepper->count = count;
+
+    for (int i = count / 2 - 1; i >= 0; i--) {
+        stepper_sift_down(stepper, i);
+    }
+}
+
+/**
+ * Cleans up a `Stepper`, freeing its scheduling arrays.
+ *
+ * @param[in,out] stepper  Pointer to the `Stepper` to clean.
+ */
+void stepper_clean(Stepper *stepper) {
+    free(stepper->heap);
+    free(stepper->next_times);
+    free(stepper->phases);
+    stepper->count = 0;
+}
+
+/**
+ * Advances the simulation by `dt` virtual milliseconds.
+ *
+ * Performs every system action and manager pass due before the new time, in time order, on the calling thread.
+ * Systems behave as in `system_run`, except that processing times and retry waits pass in virtual time instead of sleeping.
+ * Stops early if the manager ends the simulation.
+ *
+ * @param[in,out] stepper  Pointer to the `Stepper`.
+ * @param[in,out] manager  Pointer to the `Manager` the stepper was initialized with.
+ * @param[in]     dt       Virtual milliseconds to advance.
+ */
+void stepper_advance(Stepper *stepper, Manager *manager, double dt) {
+    double target = stepper->time + dt;
+
+    while (manager->simulation_running) {
+        double next_system_time = (stepper->count > 0) ? stepper->next_times[stepper->heap[0]] : INFINITY;
+
+        if (stepper->next_manager_time <= next_system_time && stepper->next_manager_time <= target) {
+            stepper->time = stepper->next_manager_time;
+            manager->clock = stepper->time;
+            manager_run(manager);
+            stepper->next_manager_time += MANAGER_WAIT_TIME;
+            continue;
+        }
+
+        if (next_system_time > target) {
+            break;
+        }
+
+        stepper->time = next_system_time;
+        stepper_run_system(stepper, manager, stepper->heap[0]);
+        stepper_sift_down(stepper, 0);
+    }
+
+    if (manager->simulation_running) {
+        stepper->time = target;
+    }
+}
+
+/**
+ * Performs the next action of one system and schedules the one after it.
+ *
+ * @param[in,out] stepper    Pointer to the `Stepper`.
+ * @param[in,out] manager    Pointer to the `Manager`.
+ * @param[in]     system_id  Id of the system whose action is due.
+ */
+static void stepper_run_system(Stepper *stepper, Manager *manager, int system_id) {
+    System *system = manager->system_array.systems[system_id];
+    int result_status;
+
+    if (system->status == TERMINATE || system->parked) {
+        stepper->next_times[system_id] = INFINITY;
+        return;
+    }
+
+    if (stepper->phases[system_id] == STEP_WAITING_INPUT && system->amount_stored == 0) {
+        result_status = system->reserve_output ? system_consume_reserved(system) : system_consume(system);
+        if (result_status == STATUS_CAPACITY) {
+            // A refused reservation holds nothing, the manager only needs to hear about it once
+            if (system->consecutive_failures++ == 0) {
+                system_report(system, system->produced.resource, result_status, PRIORITY_LOW);
+            }
+            stepper->next_times[system_id] += SYSTEM_WAIT_TIME;
+        } else if (result_status != STATUS_OK) {
+            system_report(system, system->consumed.resource, result_status, PRIORITY_HIGH);
+            stepper->next_times[system_id] += SYSTEM_WAIT_TIME;
+        } else {
+            double delay = system_processing_delay(system);
+            system->consecutive_failures = 0;
+            stepper->phases[system_id] = STEP_PROCESSING;
+            stepper->next_times[system_id] += (delay > STEP_MIN_DELAY) ? delay : STEP_MIN_DELAY;
+        }
+        return;
+    }
+
+    if (stepper->phases[system_id] == STEP_PROCESSING && system->reserve_output) {
+        system_commit_reserved(system);
+        stepper->phases[system_id] = STEP_WAITING_INPUT;
+        return;
+    }
+
+    if (stepper->phases[system_id] == STEP_PROCESSING && system->produced.resource) {
+        system->amount_stored += system->produced.amount * system->active_copies;
+    }
+
+    // Storing happens at the same virtual time as the end of processing, like in `system_run`
+    result_status = system_store_resources(system);
+    if (result_status != STATUS_OK) {
+        system_report(system, system->produced.resource, result_status, PRIORITY_LOW);
+        stepper->phases[system_id] = STEP_STORING;
+        stepper->next_times[system_id] += SYSTEM_WAIT_TIME;
+    } else {
+        stepper->phases[system_id] = STEP_WAITING_INPUT;
+    }
+}
+
+/**
+ * Compares two systems by the time of their next action, breaking ties by id so runs are deterministic.
+ *
+ * @param[in] stepper  Pointer to the `Stepper`.
+ * @param[in] a        Id of the first system.
+ * @param[in] b        Id of the second system.
+ * @return             Non-zero if `a` acts before `b`.
+ */
+static int stepper_earlier(const Stepper *stepper, int a, int b) {
+    double time_a = stepper->next_times[a];
+    double time_b = stepper->next_times[b];
+    return (time_a < time_b) || (time_a == time_b && a < b);
+}
+
+/**
+ * Restores the heap order after the time of the system at `index` was pushed later.
+ *
+ * @param[in,out] stepper  Pointer to the `Stepper`.
+ * @param[in]     index    Position in the heap of the system that moved.
+ */
+static void stepper_sift_down(Stepper *stepper, int index) {
+    int *heap = stepper->heap;
+    int id = heap[index];
+
+    while (1) {
+        int child = 2 * index + 1;
+        if (child >= stepper->count) {
+            break;
+        }
+        if (child + 1 < stepper->count && stepper_earlier(stepper, heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!stepper_earlier(stepper, heap[child], id)) {
+            break;
+        }
+        heap[index] = heap[child];
+        index = child;
+    }
+    heap[index] = id;
+}
@@ -3,13 +3,22 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <sched.h>
+#include <time.h>
 
 // Helper functions just used by this C file to clean up our code
 // Using static means they can't get linked into other files
 
 static int system_convert(System *system);
 static void system_simulate_process_time(System *system);
-static int system_store_resources(System *system);
+static void system_retry_failed(System *system, Resource *resource, int status, int priority);
+static void system_run_reserved(System *system);
+static int system_copies_available(const System *system, int available, int per_copy);
+static int system_queue_free(const System *system, const Resource *resource);
+static void system_park(System *system, Resource *resource, int status);
+static void system_journal_resource(System *system, Resource *resource);
+static void system_journal_stored(System *system);
+static void system_return_granted(System *system);
 
 /**
  * Creates a new `System` object.
@@ -27,11 +36,36 @@ static int system_store_resources(System *system);
 void system_create(System **system, const char *name, ResourceAmount consumed, ResourceAmount produced, int processing_time, EventQueue *event_queue) {
     *system = (System *)malloc(sizeof(System));
     (*system)->name = strdup(name);
+    (*system)->id = -1;
     (*system)->consumed = consumed;
     (*system)->produced = produced;
     (*system)->amount_stored = 0;
     (*system)->processing_time = processing_time;
+    (*system)->distribution = DIST_CONSTANT;
+    (*system)->spread = 0.0;
+    rng_seed(&(*system)->rng, DEFAULT_SEED, 0);
     (*system)->status = STANDARD;
+    (*system)->backoff_strategy = BACKOFF_FIXED;
+    (*system)->consecutive_failures = 0;
+    (*system)->unreported_wait = 0;
+    (*system)->reserve_output = 0;
+    (*system)->silent = 0;
+    (*system)->multiplicity = 1;
+    (*system)->active_copies = 0;
+    (*system)->parked = 0;
+    (*system)->waiting_on = NULL;
+    (*system)->wait_level = 0;
+    (*system)->wait_for_space = 0;
+    (*system)->next_waiter = NULL;
+    (*system)->weight = SYSTEM_DEFAULT_WEIGHT;
+    (*system)->granted_copies = 0;
+    (*system)->promised_input = 0;
+    (*system)->promised_space = 0;
+    (*system)->overtaken = 0;
+    (*system)->journal = NULL;
+    (*system)->gate = NULL;
+    sem_init(&(*system)->wake, 0, 0);
+    memset(&(*system)->metrics, 0, sizeof(SystemMetrics));
     (*system)->event_queue = event_queue;
 }
 
@@ -44,6 +78,7 @@ void system_create(System **system, const char *name, ResourceAmount consumed, R
  */
 void system_destroy(System *system) {
     if (system) {
+        sem_destroy(&system->wake);
         free(system->name);
         free(system);
     }
@@ -60,26 +95,184 @@ void system_destroy(System *system) {
  * @param[in,out] system  Pointer to the `System` to run.
  */
 void system_run(System *system) {
-    Event event;
     int result_status;
 
+    if (system->reserve_output && system->amount_stored == 0) {
+        system_run_reserved(system);
+        return;
+    }
+
     if (system->amount_stored == 0) {
         result_status = system_convert(system);
         if (result_status != STATUS_OK) {
-            event_init(&event, system, system->consumed.resource, result_status, PRIORITY_HIGH, system->consumed.resource->amount);
-            event_queue_push(system->event_queue, &event);
-            usleep(SYSTEM_WAIT_TIME * 1000);
+            system_retry_failed(system, system->consumed.resource, result_status, PRIORITY_HIGH);
+        } else {
+            system->consecutive_failures = 0;
         }
     }
 
     if (system->amount_stored > 0) {
         result_status = system_store_resources(system);
         if (result_status != STATUS_OK) {
-            event_init(&event, system, system->produced.resource, result_status, PRIORITY_LOW, system->produced.resource->amount);
-            event_queue_push(system->event_queue, &event);
-            usleep(SYSTEM_WAIT_TIME * 1000);
+            system_retry_failed(system, system->produced.resource, result_status, PRIORITY_LOW);
+        } else {
+            system->consecutive_failures = 0;
+        }
+    }
+}
+
+/**
+ * Runs one cycle of a `System` in reserve mode.
+ *
+ * The input is consumed and the output space reserved together, so a cycle only starts if it can complete:
+ * after processing the output is committed without ever finding the resource at capacity.
+ * A refused reservation holds no input and parks until the output has room (see `system_retry_failed`).
+ *
+ * @param[in,out] system  Pointer to the `System` to run.
+ */
+static void system_run_reserved(System *system) {
+    int result_status = system_consume_reserved(system);
+
+    if (result_status == STATUS_CAPACITY) {
+        system_retry_failed(system, system->produced.resource, result_status, PRIORITY_LOW);
+    } else if (result_status != STATUS_OK) {
+        system_retry_failed(system, system->consumed.resource, result_status, PRIORITY_HIGH);
+    } else {
+        system->consecutive_failures = 0;
+        system_simulate_process_time(system);
+        system_commit_reserved(system);
+    }
+}
+
+/**
+ * Reports a failed step of a `System` and waits before it is retried.
+ *
+ * With `BACKOFF_FIXED` every failure is reported and followed by a `SYSTEM_WAIT_TIME` sleep.
+ * With `BACKOFF_ADAPTIVE` the first `BACKOFF_SPIN_ATTEMPTS` retries only yield the processor, so a resource
+ * which refills quickly is picked up at once, then the sleep doubles from `BACKOFF_MIN_WAIT` up to `BACKOFF_MAX_WAIT`.
+ * The first failure sends an event, after which events are limited to one per `SYSTEM_WAIT_TIME` slept,
+ * so the adaptive strategy never reports more often than the fixed one.
+ * With `BACKOFF_PARK` every failure is reported and the system then parks on the resource (see `system_park`),
+ * so the next attempt is only made once it can succeed. `BACKOFF_QUEUE` parks the same way on the resource's queue,
+ * and a consumer is usually woken with its input already handed over (see `resource_wake_waiters`).
+ * A reservation refused in reserve mode holds no input, so it is reported once and the system then parks on the
+ * output whatever its strategy: it is woken as soon as a consumer frees the room for a cycle, instead of polling
+ * the full resource and adding to the event traffic.
+ * `consecutive_failures` is reset by the caller when a step succeeds.
+ *
+ * @param[in,out] system    Pointer to the `System` whose step failed.
+ * @param[in]     resource  Pointer to the `Resource` the step failed on.
+ * @param[in]     status    Status describing the failure.
+ * @param[in]     priority  Priority of the event sent to the manager.
+ */
+static void system_retry_failed(System *system, Resource *resource, int status, int priority) {
+    int failures = system->consecutive_failures++;
+    int report_once = system->reserve_output && status == STATUS_CAPACITY;
+
+    system->metrics.retries++;
+
+    if (system->backoff_strategy == BACKOFF_PARK || system->backoff_strategy == BACKOFF_QUEUE || report_once) {
+        system->metrics.lost_races += (failures > 0);
+        if (failures == 0 || !report_once) {
+            system_report(system, resource, status, priority);
         }
+        system_park(system, resource, status);
+        return;
+    }
+
+    if (system->backoff_strategy != BACKOFF_ADAPTIVE) {
+        system_report(system, resource, status, priority);
+        usleep(SYSTEM_WAIT_TIME * 1000);
+        system->metrics.sleeps++;
+        return;
+    }
+
+    if (failures == 0) {
+        system_report(system, resource, status, priority);
+        system->unreported_wait = 0;
+    }
+
+    if (failures < BACKOFF_SPIN_ATTEMPTS) {
+        sched_yield();
+        system->metrics.spins++;
+        return;
+    }
+
+    int doublings = failures - BACKOFF_SPIN_ATTEMPTS;
+    long wait = BACKOFF_MIN_WAIT;
+    while (doublings-- > 0 && wait < BACKOFF_MAX_WAIT) {
+        wait *= 2;
+    }
+    if (wait > BACKOFF_MAX_WAIT) {
+        wait = BACKOFF_MAX_WAIT;
+    }
+
+    system->unreported_wait += wait;
+    if (system->unreported_wait >= SYSTEM_WAIT_TIME * 1000) {
+        system_report(system, resource, status, priority);
+        system->unreported_wait = 0;
+    }
+    usleep((useconds_t)wait);
+    system->metrics.sleeps++;
+}
+
+/**
+ * Parks a `System` on the resource its step failed on, off the scheduler until the resource reaches the level needed.
+ *
+ * An input must hold one cycle's worth again. An output must have room for one more unit, as a store takes whatever
+ * fits, or for a whole cycle in reserve mode. The thread then sleeps on the system's semaphore: it costs no CPU and
+ * no wakeups until a store or consume on the resource reaches that level, or the simulation terminates.
+ *
+ * @param[in,out] system    Pointer to the `System` whose step failed.
+ * @param[in,out] resource  Pointer to the `Resource` the step failed on.
+ * @param[in]     status    Status describing the failure.
+ */
+static void system_park(System *system, Resource *resource, int status) {
+    struct timespec start, end;
+
+    system->wait_for_space = (status == STATUS_CAPACITY);
+    if (!system->wait_for_space) {
+        system->wait_level = system->consumed.amount;
+    } else if (system->reserve_output) {
+        system->wait_level = system->produced.amount;
+        if (system->consumed.resource == resource) {
+            system->wait_level -= system->consumed.amount;
+        }
+    } else {
+        system->wait_level = 1;
+    }
+
+    if (!resource_park(resource, system)) {
+        return;
     }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (sem_wait(&system->wake) != 0) {
+        // Interrupted by a signal, keep waiting
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    system->metrics.parks++;
+    system->metrics.parked_ms += (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+/**
+ * Sends an event about a `System` to the manager.
+ *
+ * @param[in,out] system    Pointer to the `System` sending the event.
+ * @param[in]     resource  Pointer to the `Resource` the event is about.
+ * @param[in]     status    Status code of the event.
+ * @param[in]     priority  Priority of the event.
+ */
+void system_report(System *system, Resource *resource, int status, int priority) {
+    Event event;
+
+    if (system->silent) {
+        return;
+    }
+
+    event_init(&event, system, resource, status, priority, resource->amount);
+    event_queue_push(system->event_queue, &event);
+    system->metrics.events++;
 }
 
 /**
@@ -88,45 +281,122 @@ void system_run(System *system) {
  * Handles the consumption of required resources and simulates processing time.
  * Updates the amount of produced resources based on the system's configuration.
  *
- * @param[in,out] system           Pointer to the `System` performing the conversion.
- * @param[out]    amount_produced  Pointer to the integer tracking the amount of produced resources.
- * @return                         `STATUS_OK` if successful, or an error status code.
+ * @param[in,out] system  Pointer to the `System` performing the conversion.
+ * @return                `STATUS_OK` if successful, or an error status code.
  */
 static int system_convert(System *system) {
+    int result_status = system_consume(system);
+
+    if (result_status == STATUS_OK) {
+        system_simulate_process_time(system);
+        if (system->produced.resource) {
+            system->amount_stored += system->produced.amount * system->active_copies;
+            system_journal_stored(system);
+        }
+    }
+    return result_status;
+}
+
+/**
+ * Takes the input of one cycle from the consumed resource.
+ *
+ * Does not wait for the processing time, so it can be used both by the threaded loop and by the `Stepper`.
+ * An aggregated system takes the input of as many of its copies as the resource can feed (at least one),
+ * and records how many in `active_copies` so the cycle produces for exactly those.
+ * Input handed over while the system was queued is taken without locking; a queued consumer does not take
+ * input while others are queued before it, and fails as if the input were short.
+ *
+ * @param[in,out] system  Pointer to the `System` consuming its input.
+ * @return                `STATUS_OK` if the input was taken, `STATUS_EMPTY` or `STATUS_INSUFFICIENT` otherwise.
+ */
+int system_consume(System *system) {
     Resource *consumed_resource = system->consumed.resource;
     int amount_consumed = system->consumed.amount;
 
     if (!consumed_resource) {
+        system->active_copies = system->multiplicity;
+        system->metrics.cycles++;
+        return STATUS_OK;
+    }
+    if (system->granted_copies > 0) {
+        system->active_copies = system->granted_copies;
+        system->granted_copies = 0;
+        system->metrics.cycles++;
+        system->metrics.handoffs++;
         return STATUS_OK;
     }
 
-    sem_wait(&consumed_resource->lock);  
-    if (consumed_resource->amount >= amount_consumed) {
-        consumed_resource->amount -= amount_consumed;
-        sem_post(&consumed_resource->lock);  
-        system_simulate_process_time(system);
-        if (system->produced.resource) {
-            system->amount_stored += system->produced.amount;
-        }
+    lock_acquire(&consumed_resource->lock);  
+    int copies = system_queue_free(system, consumed_resource) ?
+                 system_copies_available(system, consumed_resource->amount - consumed_resource->promised,
+                                         amount_consumed) : 0;
+    if (copies > 0) {
+        consumed_resource->amount -= amount_consumed * copies;
+        consumed_resource->consumed += amount_consumed * copies;
+        system_journal_resource(system, consumed_resource);
+        resource_wake_waiters(consumed_resource);
+        lock_release(&consumed_resource->lock);  
+        system->active_copies = copies;
+        system->metrics.cycles++;
         return STATUS_OK;
     } else {
-        sem_post(&consumed_resource->lock);  
+        lock_release(&consumed_resource->lock);  
+        system->metrics.failed_cycles++;
         return (consumed_resource->amount == 0) ? STATUS_EMPTY : STATUS_INSUFFICIENT;
     }
 }
 
+/**
+ * Returns how many copies of a `System` can run a cycle from `available` units.
+ *
+ * @param[in] system     Pointer to the `System`.
+ * @param[in] available  Units available (input left, or output space).
+ * @param[in] per_copy   Units one copy needs for a cycle.
+ * @return               Between 0 and `multiplicity`.
+ */
+static int system_copies_available(const System *system, int available, int per_copy) {
+    if (per_copy <= 0) {
+        return system->multiplicity;
+    }
+    int copies = (available > 0) ? available / per_copy : 0;
+    return (copies < system->multiplicity) ? copies : system->multiplicity;
+}
+
+/**
+ * Checks that a `BACKOFF_QUEUE` consumer would not overtake consumers queued on its input.
+ * A reserve mode consumer woken from the head of the queue, with its `promised_input`, passes the ones behind it.
+ *
+ * @param[in] system    Pointer to the `System`.
+ * @param[in] resource  Pointer to the locked consumed `Resource`.
+ * @return              Non-zero if the system may take input now.
+ */
+static int system_queue_free(const System *system, const Resource *resource) {
+    return system->backoff_strategy != BACKOFF_QUEUE || resource->queued_inputs == 0 || system->promised_input > 0;
+}
+
 /**
  * Simulates the processing time for a `System`.
  *
- * Adjusts the processing time based on the system's current status (e.g., SLOW, FAST)
- * and sleeps for the adjusted time to simulate processing.
+ * Sleeps for the adjusted processing time of this cycle to simulate processing.
  *
  * @param[in] system  Pointer to the `System` whose processing time is being simulated.
  */
 static void system_simulate_process_time(System *system) {
-    int adjusted_processing_time = system->processing_time;
+    usleep((useconds_t)(system_processing_delay(system) * 1000));
+}
 
-    switch (system->status) {
+/**
+ * Returns how long the next cycle of a `System` takes.
+ *
+ * Samples the processing time for this cycle and adjusts it based on the system's current status (e.g., SLOW, FAST).
+ *
+ * @param[in,out] system  Pointer to the `System`.
+ * @return                Adjusted processing time in milliseconds.
+ */
+double system_processing_delay(System *system) {
+    double adjusted_processing_time = system_sample_processing_time(system);
+
+    switch (system_speed(system)) {
         case SLOW:
             adjusted_processing_time *= 2;
             break;
@@ -137,45 +407,263 @@ static void system_simulate_process_time(System *system) {
             break;
     }
 
-    usleep(adjusted_processing_time * 1000);
+    return adjusted_processing_time;
+}
+
+/**
+ * Returns the status a `System` currently runs at.
+ *
+ * A running system follows the control word of the resource it produces when the manager has set one,
+ * so one write changes the speed of every producer; otherwise, and once terminated or disabled, its own status applies.
+ * A system parked by `manager_prune` is reported as DISABLED.
+ *
+ * @param[in] system  Pointer to the `System`.
+ * @return            The effective status (TERMINATE, DISABLED, SLOW, STANDARD or FAST).
+ */
+int system_speed(const System *system) {
+    Resource *produced_resource = system->produced.resource;
+    int status = system->status;
+
+    if (system->parked) {
+        return DISABLED;
+    }
+    if (produced_resource && status != TERMINATE && status != DISABLED) {
+        int group_status = __atomic_load_n(&produced_resource->control->status, __ATOMIC_RELAXED);
+        if (group_status != CONTROL_NONE) {
+            return group_status;
+        }
+    }
+    return status;
+}
+
+/**
+ * Sets how the processing time of a `System` varies between cycles.
+ *
+ * @param[in,out] system        Pointer to the `System`.
+ * @param[in]     distribution  One of `DIST_CONSTANT`, `DIST_UNIFORM`, `DIST_NORMAL` or `DIST_EXPONENTIAL`.
+ * @param[in]     spread        Half-width of the uniform range or standard deviation of the normal distribution, in milliseconds.
+ */
+void system_set_distribution(System *system, int distribution, double spread) {
+    system->distribution = distribution;
+    system->spread = spread;
+}
+
+/**
+ * Samples the processing time of the next cycle of a `System`.
+ *
+ * Draws from the system's own random stream, so it must only be called from the thread running the system.
+ * The result is never negative; the status adjustment is applied by the caller.
+ *
+ * @param[in,out] system  Pointer to the `System`.
+ * @return                Processing time in milliseconds.
+ */
+double system_sample_processing_time(System *system) {
+    double mean = system->processing_time;
+    double sample;
+
+    switch (system->distribution) {
+        case DIST_UNIFORM:
+            sample = mean + system->spread * (2.0 * rng_uniform(&system->rng) - 1.0);
+            break;
+        case DIST_NORMAL:
+            sample = mean + system->spread * rng_normal(&system->rng);
+            break;
+        case DIST_EXPONENTIAL:
+            sample = mean * rng_exponential(&system->rng);
+            break;
+        default:
+            sample = mean;
+            break;
+    }
+
+    return (sample > 0.0) ? sample : 0.0;
 }
 
 /**
  * Stores produced resources in a `System`.
  *
  * Attempts to add the produced resources to the corresponding resource's amount,
- * considering the maximum capacity. Updates the `produced_resource_count` to reflect
+ * considering the maximum capacity. Updates `amount_stored` to reflect
  * any leftover resources that couldn't be stored.
  *
- * @param[in,out] system                   Pointer to the `System` storing resources.
- * @param[in,out] produced_resource_count  Pointer to the integer value of how many resources need to be stored, updated with the amount that could not be stored.
- * @return                                 `STATUS_OK` if all resources were stored, or `STATUS_CAPACITY` if not all could be stored.
+ * @param[in,out] system  Pointer to the `System` storing resources.
+ * @return                `STATUS_OK` if all resources were stored, or `STATUS_CAPACITY` if not all could be stored.
  */
-static int system_store_resources(System *system) {
+int system_store_resources(System *system) {
     Resource *produced_resource = system->produced.resource;
 
     if (!produced_resource || system->amount_stored == 0) {
         return STATUS_OK;
     }
 
-    sem_wait(&produced_resource->lock); 
+    lock_acquire(&produced_resource->lock); 
 
-    int available_space = produced_resource->max_capacity - produced_resource->amount;
+    produced_resource->promised_space -= system->promised_space;   // The system's own share is now free to it
+    system->promised_space = 0;
+    int available_space = produced_resource->max_capacity - produced_resource->amount - produced_resource->reserved -
+                          produced_resource->promised_space;
 
     if (available_space >= system->amount_stored) {
         produced_resource->amount += system->amount_stored;
+        produced_resource->produced += system->amount_stored;
         system->amount_stored = 0;
-        sem_post(&produced_resource->lock); 
+        system_journal_resource(system, produced_resource);
+        system_journal_stored(system);
+        resource_wake_waiters(produced_resource);
+        lock_release(&produced_resource->lock); 
         return STATUS_OK;
     } else if (available_space > 0) {
         produced_resource->amount += available_space;
+        produced_resource->produced += available_space;
         system->amount_stored -= available_space;
+        system_journal_resource(system, produced_resource);
+        system_journal_stored(system);
+        resource_wake_waiters(produced_resource);
     }
 
-    sem_post(&produced_resource->lock);  
+    lock_release(&produced_resource->lock);  
+    system->metrics.failed_stores++;
     return STATUS_CAPACITY;
 }
 
+/**
+ * Takes the input of one cycle and reserves space for its output in a single step.
+ *
+ * Both resources are locked in id order, so two systems reserving across the same pair cannot deadlock.
+ * Nothing is changed unless both the input and the output space are available.
+ * When a system consumes and produces the same resource, the consumed units count as free space.
+ * An aggregated system starts as many copies as both sides allow, recorded in `active_copies`.
+ *
+ * @param[in,out] system  Pointer to the `System` starting a cycle.
+ * @return                `STATUS_OK` if the cycle may start, `STATUS_EMPTY` or `STATUS_INSUFFICIENT` if the input
+ *                        is missing, or `STATUS_CAPACITY` if the output has no room for the cycle's production.
+ */
+int system_consume_reserved(System *system) {
+    Resource *consumed_resource = system->consumed.resource;
+    Resource *produced_resource = system->produced.resource;
+    Resource *first = consumed_resource ? consumed_resource : produced_resource;
+    Resource *second = (consumed_resource && produced_resource != consumed_resource) ? produced_resource : NULL;
+    int result_status = STATUS_OK;
+
+    if (second && second->id < first->id) {
+        Resource *swap = first;
+        first = second;
+        second = swap;
+    }
+
+    if (first) {
+        lock_acquire(&first->lock);
+    }
+    if (second) {
+        lock_acquire(&second->lock);
+    }
+
+    int copies = system->multiplicity;
+    if (consumed_resource) {
+        consumed_resource->promised -= system->promised_input;   // The system's own share is now available to it
+        copies = system_queue_free(system, consumed_resource) ?
+                 system_copies_available(system, consumed_resource->amount - consumed_resource->promised,
+                                         system->consumed.amount) : 0;
+    }
+    system->promised_input = 0;   // Used or lost, a system failing again queues behind the others
+    if (produced_resource) {
+        produced_resource->promised_space -= system->promised_space;
+    }
+    system->promised_space = 0;
+
+    if (copies == 0) {
+        result_status = (consumed_resource->amount == 0) ? STATUS_EMPTY : STATUS_INSUFFICIENT;
+    } else if (produced_resource) {
+        int available_space = produced_resource->max_capacity - produced_resource->amount - produced_resource->reserved -
+                              produced_resource->promised_space;
+        int per_copy = system->produced.amount;
+        if (produced_resource == consumed_resource) {
+            per_copy -= system->consumed.amount;  // Consuming frees space, each copy needs only the difference
+        }
+        int fitting = system_copies_available(system, available_space, per_copy);
+        copies = (fitting < copies) ? fitting : copies;
+        if (copies == 0) {
+            result_status = STATUS_CAPACITY;
+        }
+    }
+
+    if (result_status == STATUS_OK) {
+        if (consumed_resource) {
+            consumed_resource->amount -= system->consumed.amount * copies;
+            consumed_resource->consumed += system->consumed.amount * copies;
+            system_journal_resource(system, consumed_resource);
+            resource_wake_waiters(consumed_resource);
+        }
+        if (produced_resource) {
+            produced_resource->reserved += system->produced.amount * copies;
+        }
+        system->active_copies = copies;
+    }
+
+    if (second) {
+        lock_release(&second->lock);
+    }
+    if (first) {
+        lock_release(&first->lock);
+    }
+
+    if (result_status == STATUS_OK) {
+        system->metrics.cycles++;
+    } else if (result_status == STATUS_CAPACITY) {
+        system->metrics.failed_stores++;
+    } else {
+        system->metrics.failed_cycles++;
+    }
+    return result_status;
+}
+
+/**
+ * Stores the output of a cycle started with `system_consume_reserved`, turning its reservation into stored units.
+ *
+ * Always succeeds, as the space was set aside when the cycle started.
+ *
+ * @param[in,out] system  Pointer to the `System` finishing its cycle.
+ */
+void system_commit_reserved(System *system) {
+    Resource *produced_resource = system->produced.resource;
+
+    if (!produced_resource) {
+        return;
+    }
+
+    lock_acquire(&produced_resource->lock);
+    produced_resource->reserved -= system->produced.amount * system->active_copies;
+    produced_resource->amount += system->produced.amount * system->active_copies;
+    produced_resource->produced += system->produced.amount * system->active_copies;
+    system_journal_resource(system, produced_resource);
+    resource_wake_waiters(produced_resource);
+    lock_release(&produced_resource->lock);
+}
+
+/**
+ * Records the new amount of a `Resource` changed by a `System`, if the system is being recorded.
+ *
+ * Must be called with the resource locked, so its records are in the order of the changes.
+ *
+ * @param[in] system    Pointer to the `System` which changed the resource.
+ * @param[in] resource  Pointer to the locked `Resource`.
+ */
+static void system_journal_resource(System *system, Resource *resource) {
+    if (system->journal) {
+        journal_record(system->journal, JOURNAL_RESOURCE, resource->id, resource->amount);
+    }
+}
+
+/**
+ * Records the new amount held by a `System` waiting to be stored, if the system is being recorded.
+ *
+ * @param[in] system  Pointer to the `System`.
+ */
+static void system_journal_stored(System *system) {
+    if (system->journal) {
+        journal_record(system->journal, JOURNAL_STORED, system->id, system->amount_stored);
+    }
+}
 
 /**
  * Initializes the `SystemArray`.
@@ -208,6 +696,7 @@ void system_array_clean(SystemArray *array) {
  * Adds a `System` to the `SystemArray`, resizing if necessary (doubling the size).
  *
  * Resizes the array when the capacity is reached and adds the new `System`.
+ * The system's `id` is set to its index in the array and it is registered as a producer of its output.
  * Use of realloc is NOT permitted.
  *
  * @param[in,out] array   Pointer to the `SystemArray`.
@@ -223,13 +712,61 @@ void system_array_add(SystemArray *array, System *system) {
         free(array->systems);
         array->systems = new_array;
     }
+    system->id = array->size;
     array->systems[array->size++] = system;
+
+    if (system->produced.resource) {
+        resource_add_producer(system->produced.resource, system);
+    }
 }
 
 void *system_thread(void *arg) {
     System *system = (System *)arg;
+    profiler_thread_start(PROFILE_SYSTEM);
     while (system->status != TERMINATE) {
+        if (system->gate) {
+            pause_gate_pass(system->gate);
+        }
         system_run(system);
     }
+    system_return_granted(system);
+    profiler_thread_stop();
     return NULL;
+}
+
+/**
+ * Puts back the input handed over to a `System` which stopped before taking it, so no unit is lost,
+ * and releases the input and space set aside for it.
+ *
+ * A queued system can be handed its input (or have it or its space promised) and then see TERMINATE before
+ * its next attempt.
+ *
+ * @param[in,out] system  Pointer to the `System` whose thread is exiting.
+ */
+static void system_return_granted(System *system) {
+    Resource *consumed_resource = system->consumed.resource;
+    Resource *produced_resource = system->produced.resource;
+    int returned = system->consumed.amount * system->granted_copies;
+
+    if (system->promised_space > 0) {
+        lock_acquire(&produced_resource->lock);
+        produced_resource->promised_space -= system->promised_space;
+        resource_wake_waiters(produced_resource);
+        lock_release(&produced_resource->lock);
+        system->promised_space = 0;
+    }
+    if (returned == 0 && system->promised_input == 0) {
+        return;
+    }
+    lock_acquire(&consumed_resource->lock);
+    consumed_resource->promised -= system->promised_input;
+    if (returned > 0) {
+        consumed_resource->amount += returned;
+        consumed_resource->consumed -= returned;
+        system_journal_resource(system, consumed_resource);
+    }
+    resource_wake_waiters(consumed_resource);
+    lock_release(&consumed_resource->lock);
+    system->granted_copies = 0;
+    system->promised_input = 0;
 }
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "defs.h"
+#include <stdlib.h>
+#include <string.h>
+
+// File format, all values in host byte order:
+//   header   TRACE_MAGIC, resource count, system count (int32 each)
+//   records  one `TraceRecord` per event handed to the manager, in the order it saw them
+#define TRACE_MAGIC "RSTRACE1"
+#define TRACE_DIGEST_BASIS 14695981039346656037ULL   // FNV-1a offset basis
+#define TRACE_DIGEST_PRIME 1099511628211ULL
+
+// Helper functions just used by this C file
+// Using static means they can't get linked into other files
+
+static void trace_save_state(Manager *manager, int *statuses, int *controls, int *running);
+static void trace_restore_state(Manager *manager, const int *statuses, const int *controls, int running);
+static uint64_t trace_digest_add(uint64_t digest, int value);
+static int trace_batch_size(const double *times, long first, long count);
+
+/**
+ * Opens a `Trace` writing every event the manager handles to `path`.
+ *
+ * The manager only records while its `trace` pointer is set; the caller sets it once the trace is open.
+ *
+ * @param[out] trace    Pointer to the `Trace` to open.
+ * @param[in]  path     File to create (truncated if it exists).
+ * @param[in]  manager  Pointer to the `Manager` whose events are recorded.
+ * @return              0 on success, -1 if the file could not be created or its header written.
+ */
+int trace_open(Trace *trace, const char *path, Manager *manager) {
+    int32_t header[2];
+
+    trace->file = fopen(path, "wb");
+    if (!trace->file) {
+        return -1;
+    }
+    trace->records = 0;
+    trace->failed = 0;
+
+    header[0] = manager->resource_array.size;
+    header[1] = manager->system_array.size;
+    if (fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), trace->file) != sizeof(TRACE_MAGIC) ||
+        fwrite(header, sizeof(int32_t), 2, trace->file) != 2) {
+        fclose(trace->file);
+        trace->file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Closes a `Trace`. The manager must have stopped recording first.
+ *
+ * @param[in,out] trace  Pointer to the `Trace` to close.
+ * @return               0 on success, -1 if any write since `trace_open` failed (the trace is truncated).
+ */
+int trace_close(Trace *trace) {
+    if (fclose(trace->file) != 0) {
+        trace->failed = 1;   // The last buffered records are only written here
+    }
+    trace->file = NULL;
+    return trace->failed ? -1 : 0;
+}
+
+/**
+ * Appends one event to the `Trace`. Only called from the manager thread, so no lock is needed.
+ * A short write marks the trace as failed, which `trace_close` reports; the run goes on.
+ *
+ * @param[in,out] trace  Pointer to the `Trace`.
+ * @param[in]     time   Manager clock when the event was handled, in milliseconds.
+ * @param[in]     event  Pointer to the `Event`.
+ */
+void trace_record(Trace *trace, double time, const Event *event) {
+    TraceRecord record;
+
+    record.time = time;
+    record.system = event->system ? event->system->id : -1;
+    record.resource = event->resource ? event->resource->id : -1;
+    record.status = (int16_t)event->status;
+    record.priority = (int16_t)event->priority;
+    record.amount = event->amount;
+    if (fwrite(&record, sizeof(record), 1, trace->file) != 1) {
+        trace->failed = 1;
+        return;
+    }
+    trace->records++;
+}
+
+/**
+ * Reads a whole trace and turns its records back into events of `manager`'s simulation.
+ *
+ * @param[in]  path     Trace file written by a run of the same scenario.
+ * @param[in]  manager  Pointer to the `Manager` holding the scenario.
+ * @param[out] events   Newly allocated events, with their times in `times`; free both.
+ * @param[out] times    Newly allocated manager clock of each event.
+ * @param[out] count    Number of events.
+ * @return              0 on success, -1 if the file is missing or not a trace,
+ *                      -2 if it was recorded with other resource or system counts.
+ */
+int trace_load(const char *path, Manager *manager, Event **events, double **times, long *count) {
+    char magic[sizeof(TRACE_MAGIC)];
+    int32_t header[2];
+    TraceRecord record;
+    FILE *file = fopen(path, "rb");
+
+    if (!file) {
+        return -1;
+    }
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+        fread(header, sizeof(int32_t), 2, file) != 2) {
+        fclose(file);
+        return -1;
+    }
+    if (header[0] != manager->resource_array.size || header[1] != manager->system_array.size) {
+        fclose(file);
+        return -2;
+    }
+
+    long start = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long total = (ftell(file) - start) / (long)sizeof(TraceRecord);
+    fseek(file, start, SEEK_SET);
+
+    *events = (Event *)malloc(sizeof(Event) * (total > 0 ? total : 1));
+    *times = (double *)malloc(sizeof(double) * (total > 0 ? total : 1));
+    *count = 0;
+    while (*count < total && fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.system < 0 || record.system >= header[1] || record.resource < 0 || record.resource >= header[0]) {
+            continue;
+        }
+        event_init(&(*events)[*count], manager->system_array.systems[record.system],
+                   manager->resource_array.resources[record.resource], record.status, record.priority, record.amount);
+        (*times)[*count] = record.time;
+        (*count)++;
+    }
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Replays recorded events through the manager's decisions on the calling thread, as fast as possible.
+ *
+ * Events recorded at the same manager clock were handled in the same tick and are replayed as one batch
+ * with `manager_handle_events`, so a policy plugin sees the batches it would have seen live.
+ * The events are replayed `rounds` times from the same starting statuses, to time the decisions alone, then once
+ * more to count the speed changes each batch causes and fold them into a digest: two policies given
+ * the same trace made the same decisions if their digests match. The statuses are restored afterwards.
+ *
+ * @param[in,out] manager  Pointer to the `Manager` holding the scenario the trace was recorded with.
+ * @param[in]     events   Events loaded by `trace_load`.
+ * @param[in]     times    Manager clock of each event.
+ * @param[in]     count    Number of events.
+ * @param[in]     rounds   Number of timed replays.
+ * @param[out]    replay   Pointer to the `TraceReplay` to fill with the results.
+ */
+void trace_replay(Manager *manager, const Event *events, const double *times, long count, int rounds, TraceReplay *replay) {
+    int *statuses = (int *)malloc(sizeof(int) * (manager->system_array.size + 1));
+    int *controls = (int *)malloc(sizeof(int) * (manager->resource_array.size + 1));
+    int *before = (int *)malloc(sizeof(int) * (manager->system_array.size + 1));
+    int running;
+    int display = manager->display_enabled;
+    struct timespec start, end;
+
+    manager->display_enabled = 0;
+    trace_save_state(manager, statuses, controls, &running);
+    replay->events = count;
+    replay->rounds = rounds;
+    replay->best_ms = 0.0;
+    replay->total_ms = 0.0;
+
+    for (int round = 0; round < rounds; round++) {
+        trace_restore_state(manager, statuses, controls, running);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (long i = 0; i < count;) {
+            int batch = trace_batch_size(times, i, count);
+            manager->clock = times[i];
+            manager_handle_events(manager, &events[i], batch);
+            i += batch;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6;
+        replay->total_ms += elapsed;
+        if (round == 0 || elapsed < replay->best_ms) {
+            replay->best_ms = elapsed;
+        }
+    }
+
+    // Untimed pass: compare the speed of every system before and after each batch
+    trace_restore_state(manager, statuses, controls, running);
+    replay->changes = 0;
+    replay->terminated_at = -1;
+    replay->digest = TRACE_DIGEST_BASIS;
+    for (long i = 0; i < count;) {
+        int batch = trace_batch_size(times, i, count);
+        for (int s = 0; s < manager->system_array.size; s++) {
+            before[s] = system_speed(manager->system_array.systems[s]);
+        }
+        manager->clock = times[i];
+        manager_handle_events(manager, &events[i], batch);
+        for (int s = 0; s < manager->system_array.size; s++) {
+            int speed = system_speed(manager->system_array.systems[s]);
+            if (speed != before[s]) {
+                replay->changes++;
+                replay->digest = trace_digest_add(trace_digest_add(replay->digest, (int)i), s * 8 + speed);
+            }
+        }
+        if (!manager->simulation_running && replay->terminated_at < 0) {
+            replay->terminated_at = i;
+        }
+        i += batch;
+    }
+
+    trace_restore_state(manager, statuses, controls, running);
+    manager->display_enabled = display;
+    free(statuses);
+    free(controls);
+    free(before);
+}
+
+/**
+ * Saves everything `manager_handle_event` can change: system statuses, resource control words and the running flag.
+ */
+static void trace_save_state(Manager *manager, int *statuses, int *controls, int *running) {
+    for (int i = 0; i < manager->system_array.size; i++) {
+        statuses[i] = manager->system_array.systems[i]->status;
+    }
+    for (int i = 0; i < manager->resource_array.size; i++) {
+        controls[i] = manager->resource_array.resources[i]->control->status;
+    }
+    *running = manager->simulation_running;
+}
+
+static void trace_restore_state(Manager *manager, const int *statuses, const int *controls, int running) {
+    for (int i = 0; i < manager->system_array.size; i++) {
+        manager->system_array.systems[i]->status = statuses[i];
+    }
+    for (int i = 0; i < manager->resource_array.size; i++) {
+        manager->resource_array.resources[i]->control->status = controls[i];
+    }
+    manager->simulation_running = running;
+}
+
+static uint64_t trace_digest_add(uint64_t digest, int value) {
+    for (int i = 0; i < 4; i++) {
+        digest ^= (uint64_t)((value >> (8 * i)) & 0xFF);
+        digest *= TRACE_DIGEST_PRIME;
+    }
+    return digest;
+}
+
+/**
+ * Returns the number of events from `first` on which share its manager clock, i.e. were handled in one tick.
+ */
+static int trace_batch_size(const double *times, long first, long count) {
+    long last = first + 1;
+    while (last < count && times[last] == times[first]) {
+        last++;
+    }
+    return (int)(last - first);
+}